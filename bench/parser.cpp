@@ -0,0 +1,85 @@
+// Parser throughput on machine-generated expressions: a long flat chain of
+// operators and the same number of operators nested in parentheses.
+// Usage: parser-bench [size = 100000] [iterations = 20]
+#include "Lexer.hpp"
+#include "Parser.hpp"
+#include "Stats.hpp"
+
+#include <chrono>
+#include <cstdlib>
+#include <string>
+#include <variant>
+
+#include <fmt/core.h>
+
+namespace {
+  using Clock = std::chrono::steady_clock;
+
+  // `1 * 2 + 3 % 4 - ...`, `size` operands on a single precedence chain
+  auto wide(size_t const size) -> std::string {
+    constexpr std::string_view OPERATORS = "*+%-/";
+    std::string source{"1"};
+    for (size_t i = 1; i < size; ++i) {
+      source += fmt::format(
+          " {} {}", OPERATORS[i % OPERATORS.size()], i % 9 + 1
+      );
+    }
+    return source;
+  }
+
+  // `1 * (2 + (3 % (4 - ...)))`, every operator nested in the right operand
+  // of the previous one
+  auto deep(size_t const size) -> std::string {
+    constexpr std::string_view OPERATORS = "*+%-/";
+    std::string source{};
+    for (size_t i = 1; i < size; ++i) {
+      source += fmt::format(
+          "{} {} (", i % 9 + 1, OPERATORS[i % OPERATORS.size()]
+      );
+    }
+    source += "1";
+    source.append(size - 1, ')');
+    return source;
+  }
+
+  auto measure(
+      std::string_view const name, std::string const& source,
+      size_t const iterations
+  ) -> void {
+    Lexer lexer{source};
+    auto const tokens = lexer.receive_tokens();
+
+    Stats::Histogram latency{};
+    for (size_t i = 0; i < iterations; ++i) {
+      // Copying the tokens is part of handing them to a parser
+      auto const start = Clock::now();
+      Parser parser{tokens};
+      auto const expression = parser.receive_expressions();
+      auto const elapsed = Clock::now() - start;
+      if (auto const* error = std::get_if<std::string>(&expression)) {
+        fmt::print(stderr, "{}: {}\n", name, *error);
+        std::exit(EXIT_FAILURE);
+      }
+      latency.record(static_cast<uint64_t>(
+          std::chrono::duration_cast<std::chrono::microseconds>(elapsed)
+              .count()
+      ));
+    }
+    auto const tokens_per_second =
+        static_cast<double>(tokens.size()) / latency.mean() * 1e6;
+    fmt::print(
+        "{:<6} {:>9} tokens  min {:>7} us  p50 {:>7} us  mean {:>9.1f} us  "
+        "{:>6.1f} M tokens/s\n",
+        name, tokens.size(), latency.min(), latency.percentile(0.5),
+        latency.mean(), tokens_per_second / 1e6
+    );
+  }
+} // namespace
+
+auto main(int argc, char** argv) -> int {
+  auto const size = argc > 1 ? std::strtoull(argv[1], nullptr, 10) : 100000;
+  auto const iterations = argc > 2 ? std::strtoull(argv[2], nullptr, 10) : 20;
+
+  measure("wide", wide(size), iterations);
+  measure("deep", deep(size), iterations);
+}
@@ -0,0 +1,66 @@
+// Spawn latency of `Command::execute` from a large shell process, with and
+// without the fork server.
+// Usage: spawn-bench [heap MiB = 1024] [iterations = 200]
+#include "Command.hpp"
+#include "ForkServer.hpp"
+#include "Stats.hpp"
+
+#include <chrono>
+#include <cstdlib>
+#include <cstring>
+#include <memory>
+#include <string>
+
+#include <fmt/core.h>
+
+namespace {
+  using Clock = std::chrono::steady_clock;
+
+  auto measure(std::string_view const name, size_t const iterations) -> void {
+    Command::Invocation const invocation{.argv = {"true"}, .redirections = {}};
+    // Warms up the environment block and the `PATH` lookup
+    for (size_t i = 0; i < 10; ++i) {
+      Command::execute(invocation);
+    }
+
+    Stats::Histogram latency{};
+    for (size_t i = 0; i < iterations; ++i) {
+      auto const start = Clock::now();
+      Command::execute(invocation);
+      latency.record(static_cast<uint64_t>(
+          std::chrono::duration_cast<std::chrono::microseconds>(
+              Clock::now() - start
+          )
+              .count()
+      ));
+    }
+    fmt::print(
+        "{:<12} min {:>7} us  p50 {:>7} us  p99 {:>7} us  mean {:>9.1f} us\n",
+        name, latency.min(), latency.percentile(0.5), latency.percentile(0.99),
+        latency.mean()
+    );
+  }
+} // namespace
+
+auto main(int argc, char** argv) -> int {
+  auto const mebibytes = argc > 1 ? std::strtoull(argv[1], nullptr, 10) : 1024;
+  auto const iterations =
+      argc > 2 ? std::strtoull(argv[2], nullptr, 10) : 200;
+
+  // Started while the process is still small, like the shell does
+  if (!ForkServer::start()) {
+    fmt::print(stderr, "Could not start the fork server\n");
+    return EXIT_FAILURE;
+  }
+
+  // Touched, so every page is mapped and has to be copied into the child's
+  // page tables on `fork`
+  auto const size = mebibytes << 20;
+  auto const heap = std::make_unique_for_overwrite<char[]>(size);
+  std::memset(heap.get(), 1, size);
+  fmt::print("{} MiB heap, {} spawns of `true`\n", mebibytes, iterations);
+
+  measure("fork server", iterations);
+  ForkServer::stop();
+  measure("direct fork", iterations);
+}
@@ -0,0 +1,263 @@
+#include "Array.hpp"
+
+#include <algorithm>
+#include <cmath>
+#include <optional>
+#include <span>
+#include <stdexcept>
+
+#include <fmt/format.h>
+
+namespace {
+  using Simd::Operation;
+
+  // Largest magnitude below which every integer is exactly representable as
+  // a double. Integer storage never holds anything larger
+  constexpr int64_t EXACT_INTEGER = int64_t{1} << 53;
+  constexpr auto EXACT_LIMIT = static_cast<double>(EXACT_INTEGER);
+
+  [[nodiscard]] auto integral(double const value) -> std::optional<int64_t> {
+    if (value != std::trunc(value) || std::abs(value) > EXACT_LIMIT) {
+      return std::nullopt;
+    }
+    return static_cast<int64_t>(value);
+  }
+
+  // `number < array` is `array > number`
+  [[nodiscard]] auto mirror(Operation const operation) -> Operation {
+    switch (operation) {
+    case Operation::LESS:
+      return Operation::GREATER;
+    case Operation::LESS_EQUAL:
+      return Operation::GREATER_EQUAL;
+    case Operation::GREATER:
+      return Operation::LESS;
+    case Operation::GREATER_EQUAL:
+      return Operation::LESS_EQUAL;
+    default:
+      return operation;
+    }
+  }
+
+  // Largest magnitude among `values`
+  [[nodiscard]] auto magnitude(std::span<int64_t const> const values)
+      -> int64_t {
+    if (values.empty()) {
+      return 0;
+    }
+    return std::max(-Simd::min(values), Simd::max(values));
+  }
+
+  [[nodiscard]] auto magnitude(int64_t const value) -> int64_t {
+    return value < 0 ? -value : value;
+  }
+
+  // Whether an integer kernel gives what the double one gives. Numbers are
+  // doubles everywhere else, so integer results have to stay exact as
+  // doubles, i.e. within `EXACT_INTEGER`, which is checked against the
+  // largest magnitudes of the operands. Division is always left to doubles
+  template <class Left, class Right>
+  [[nodiscard]] auto fits_integers(
+      Operation const operation, Left const& left, Right const& right
+  ) -> bool {
+    switch (operation) {
+    case Operation::ADD:
+    case Operation::SUBTRACT:
+      return magnitude(left) + magnitude(right) <= EXACT_INTEGER;
+    case Operation::MULTIPLY: {
+      auto const factor = magnitude(left);
+      return factor == 0 || magnitude(right) <= EXACT_INTEGER / factor;
+    }
+    case Operation::DIVIDE:
+      return false;
+    default:
+      return true;
+    }
+  }
+} // namespace
+
+Array::Array(Integers elements)
+    : storage_(std::make_shared<Storage const>(std::move(elements))) {}
+
+Array::Array(Reals elements)
+    : storage_(std::make_shared<Storage const>(std::move(elements))) {}
+
+Array::Array(std::shared_ptr<Storage const> storage)
+    : storage_(std::move(storage)) {}
+
+[[nodiscard]] auto Array::from(std::vector<double> const& values) -> Array {
+  Integers integers{};
+  integers.reserve(values.size());
+  for (auto const value : values) {
+    auto const integer = integral(value);
+    if (!integer) {
+      return Array{values};
+    }
+    integers.push_back(integer.value());
+  }
+  return Array{std::move(integers)};
+}
+
+[[nodiscard]] auto Array::size() const -> size_t {
+  return std::visit(
+      [](auto const& elements) { return elements.size(); }, *storage_
+  );
+}
+
+[[nodiscard]] auto Array::is_integral() const -> bool {
+  return std::holds_alternative<Integers>(*storage_);
+}
+
+[[nodiscard]] auto Array::at(size_t const index) const -> double {
+  return std::visit(
+      [index](auto const& elements) {
+        return static_cast<double>(elements.at(index));
+      },
+      *storage_
+  );
+}
+
+[[nodiscard]] auto Array::reals() const -> Reals const& {
+  return std::get<Reals>(*storage_);
+}
+
+[[nodiscard]] auto Array::integers() const -> Integers const& {
+  return std::get<Integers>(*storage_);
+}
+
+[[nodiscard]] auto Array::as_reals() const -> std::shared_ptr<Reals const> {
+  if (!is_integral()) {
+    return {storage_, &reals()};
+  }
+  auto const& elements = integers();
+  return std::make_shared<Reals const>(elements.begin(), elements.end());
+}
+
+[[nodiscard]] auto
+Array::apply(Operation const operation, Array const& left, Array const& right)
+    -> Array {
+  if (left.size() != right.size()) {
+    throw std::logic_error(fmt::format(
+        "arrays of different sizes ({} and {}) used in binary operation",
+        left.size(), right.size()
+    ));
+  }
+
+  if (left.is_integral() && right.is_integral() &&
+      fits_integers(operation, left.integers(), right.integers())) {
+    Integers out(left.size());
+    if (Simd::is_comparison(operation)) {
+      Simd::compare(operation, left.integers(), right.integers(), out);
+    } else {
+      Simd::arithmetic(operation, left.integers(), right.integers(), out);
+    }
+    return Array{std::move(out)};
+  }
+
+  auto const left_reals = left.as_reals();
+  auto const right_reals = right.as_reals();
+  if (Simd::is_comparison(operation)) {
+    Integers out(left.size());
+    Simd::compare(operation, *left_reals, *right_reals, out);
+    return Array{std::move(out)};
+  }
+  Reals out(left.size());
+  Simd::arithmetic(operation, *left_reals, *right_reals, out);
+  return Array{std::move(out)};
+}
+
+[[nodiscard]] auto
+Array::apply(Operation const operation, Array const& left, double const right)
+    -> Array {
+  auto const integer = integral(right);
+  if (left.is_integral() && integer &&
+      fits_integers(operation, left.integers(), integer.value())) {
+    Integers out(left.size());
+    if (Simd::is_comparison(operation)) {
+      Simd::compare(operation, left.integers(), integer.value(), out);
+    } else {
+      Simd::arithmetic(operation, left.integers(), integer.value(), out);
+    }
+    return Array{std::move(out)};
+  }
+
+  auto const reals = left.as_reals();
+  if (Simd::is_comparison(operation)) {
+    Integers out(left.size());
+    Simd::compare(operation, *reals, right, out);
+    return Array{std::move(out)};
+  }
+  Reals out(left.size());
+  Simd::arithmetic(operation, *reals, right, out);
+  return Array{std::move(out)};
+}
+
+[[nodiscard]] auto
+Array::apply(Operation const operation, double const left, Array const& right)
+    -> Array {
+  if (Simd::is_comparison(operation)) {
+    return apply(mirror(operation), right, left);
+  }
+
+  auto const integer = integral(left);
+  if (right.is_integral() && integer &&
+      fits_integers(operation, integer.value(), right.integers())) {
+    Integers out(right.size());
+    Simd::arithmetic(operation, integer.value(), right.integers(), out);
+    return Array{std::move(out)};
+  }
+  Reals out(right.size());
+  Simd::arithmetic(operation, left, *right.as_reals(), out);
+  return Array{std::move(out)};
+}
+
+// Integers are only summed as such while no partial sum can leave the
+// exactly representable range
+[[nodiscard]] auto Array::sum() const -> double {
+  auto const count = std::max<int64_t>(static_cast<int64_t>(size()), 1);
+  if (is_integral() && magnitude(integers()) <= EXACT_INTEGER / count) {
+    return static_cast<double>(Simd::sum(integers()));
+  }
+  return Simd::sum(*as_reals());
+}
+
+[[nodiscard]] auto Array::min() const -> double {
+  if (size() == 0) {
+    throw std::logic_error("min of an empty array");
+  }
+  if (is_integral()) {
+    return static_cast<double>(Simd::min(integers()));
+  }
+  return Simd::min(reals());
+}
+
+[[nodiscard]] auto Array::max() const -> double {
+  if (size() == 0) {
+    throw std::logic_error("max of an empty array");
+  }
+  if (is_integral()) {
+    return static_cast<double>(Simd::max(integers()));
+  }
+  return Simd::max(reals());
+}
+
+[[nodiscard]] auto Array::display() const -> std::string {
+  return std::visit(
+      [](auto const& elements) {
+        return fmt::format("[{}]", fmt::join(elements, ", "));
+      },
+      *storage_
+  );
+}
+
+[[nodiscard]] auto Array::operator==(Array const& other) const -> bool {
+  if (size() != other.size()) {
+    return false;
+  }
+  for (size_t i = 0; i < size(); ++i) {
+    if (at(i) != other.at(i)) {
+      return false;
+    }
+  }
+  return true;
+}
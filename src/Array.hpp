@@ -0,0 +1,58 @@
+#pragma once
+#include "Simd.hpp"
+
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <variant>
+#include <vector>
+
+// Immutable numeric array value. Elements are stored contiguously as
+// `int64_t` while every one of them is an integer and as `double` otherwise,
+// so operations run as `Simd` kernels. Copies share the elements.
+class Array {
+public:
+  using Integers = std::vector<int64_t>;
+  using Reals = std::vector<double>;
+
+  explicit Array(Integers elements);
+  explicit Array(Reals elements);
+  // Integers when every value is integral and fits
+  [[nodiscard]] static auto from(std::vector<double> const& values) -> Array;
+
+  [[nodiscard]] auto size() const -> size_t;
+  [[nodiscard]] auto is_integral() const -> bool;
+  [[nodiscard]] auto at(size_t index) const -> double;
+
+  // Element-wise operations, numbers are broadcast to every element.
+  // Arrays of different sizes throw `std::logic_error`
+  [[nodiscard]] static auto
+  apply(Simd::Operation operation, Array const& left, Array const& right)
+      -> Array;
+  [[nodiscard]] static auto
+  apply(Simd::Operation operation, Array const& left, double right) -> Array;
+  [[nodiscard]] static auto
+  apply(Simd::Operation operation, double left, Array const& right) -> Array;
+
+  [[nodiscard]] auto sum() const -> double;
+  // Throw `std::logic_error` for empty arrays
+  [[nodiscard]] auto min() const -> double;
+  [[nodiscard]] auto max() const -> double;
+
+  [[nodiscard]] auto display() const -> std::string;
+
+  // Element-wise equality of the values, regardless of the storage
+  [[nodiscard]] auto operator==(Array const& other) const -> bool;
+
+private:
+  using Storage = std::variant<Integers, Reals>;
+
+  explicit Array(std::shared_ptr<Storage const> storage);
+
+  [[nodiscard]] auto reals() const -> Reals const&;
+  [[nodiscard]] auto integers() const -> Integers const&;
+  // Converted copy for integral arrays
+  [[nodiscard]] auto as_reals() const -> std::shared_ptr<Reals const>;
+
+  std::shared_ptr<Storage const> storage_;
+};
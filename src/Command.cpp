@@ -0,0 +1,719 @@
+#include "Command.hpp"
+#include "Environment.hpp"
+#include "ForkServer.hpp"
+#include "Glob.hpp"
+#include "Log.hpp"
+#include "Stats.hpp"
+
+#include <algorithm>
+#include <array>
+#include <cctype>
+#include <charconv>
+#include <cerrno>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <stdexcept>
+
+#include <csignal>
+
+#include <fcntl.h>
+#include <fmt/core.h>
+#include <poll.h>
+#include <sys/mman.h>
+#include <sys/resource.h>
+#include <sys/wait.h>
+#include <sysexits.h>
+#include <unistd.h>
+
+namespace {
+  using Redirection = Command::Redirection;
+  using Clock = std::chrono::steady_clock;
+
+  // Pipe capacity requested for captured output. Bigger pipes let the child
+  // write more before blocking and let every `read` return more at once
+  constexpr auto PIPE_SIZE = 1 << 20;
+  constexpr auto MIN_READ = 1 << 16;
+
+  using ForkServer::Action;
+
+  // Descriptors opened by the shell for a single spawn
+  class Descriptors {
+  public:
+    Descriptors() = default;
+    Descriptors(Descriptors const&) = delete;
+    auto operator=(Descriptors const&) -> Descriptors& = delete;
+    ~Descriptors() {
+      std::ranges::for_each(owned_, close);
+    }
+
+    auto own(int const fd) -> int {
+      owned_.push_back(fd);
+      return fd;
+    }
+
+  private:
+    std::vector<int> owned_;
+  };
+
+  // Here-documents are handed to the child as a sealed in-memory file: no
+  // temporary file on disk and no helper process feeding a pipe
+  auto seal_content(std::string_view const content) -> int {
+    auto const fd =
+        memfd_create("seashell-here-document", MFD_CLOEXEC | MFD_ALLOW_SEALING);
+    if (fd == -1) {
+      return -1;
+    }
+    for (size_t written = 0; written < content.size();) {
+      auto const count =
+          write(fd, content.data() + written, content.size() - written);
+      if (count == -1 && errno != EINTR) {
+        close(fd);
+        return -1;
+      }
+      written += static_cast<size_t>(std::max<ssize_t>(count, 0));
+    }
+    fcntl(
+        fd, F_ADD_SEALS,
+        F_SEAL_SHRINK | F_SEAL_GROW | F_SEAL_WRITE | F_SEAL_SEAL
+    );
+    // The offset is shared with the child after `dup2`
+    lseek(fd, 0, SEEK_SET);
+    return fd;
+  }
+
+  // Descriptor number made of digits only, e.g. the `2` of `2>file`.
+  // Numbers too large for an `int` are not descriptors either
+  auto parse_fd(std::string_view const digits) -> std::optional<int> {
+    auto fd = 0;
+    auto const [end, error] =
+        std::from_chars(digits.data(), digits.data() + digits.size(), fd);
+    if (digits.empty() || digits.front() == '-' || error != std::errc{} ||
+        end != digits.data() + digits.size()) {
+      return std::nullopt;
+    }
+    return fd;
+  }
+
+  // Moves `fd` above `floor`. Actions are applied in order, so an opened
+  // file sitting at the target of an earlier action would be replaced
+  // before its own action runs
+  auto above(int const fd, int const floor) -> int {
+    if (fd == -1 || fd > floor) {
+      return fd;
+    }
+    auto const moved = fcntl(fd, F_DUPFD_CLOEXEC, floor + 1);
+    auto const error = errno;
+    close(fd);
+    errno = error;
+    return moved;
+  }
+
+  // Opens every redirection target in the shell, so failures are reported
+  // before forking
+  auto resolve(
+      std::vector<Redirection> const& redirections, Descriptors& descriptors,
+      std::vector<Action>& actions
+  ) -> bool {
+    using Kind = Redirection::Kind;
+    constexpr auto MODE = 0666;
+
+    auto highest = STDERR_FILENO;
+    for (auto const action : actions) {
+      highest = std::max(highest, action.target);
+    }
+    for (auto const& redirection : redirections) {
+      highest = std::max(highest, redirection.fd);
+    }
+
+    for (auto const& redirection : redirections) {
+      auto source = -1;
+      switch (redirection.kind) {
+      case Kind::INPUT:
+        source = open(redirection.target.c_str(), O_RDONLY | O_CLOEXEC);
+        break;
+      case Kind::OUTPUT:
+        source = open(
+            redirection.target.c_str(),
+            O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC, MODE
+        );
+        break;
+      case Kind::APPEND:
+        source = open(
+            redirection.target.c_str(),
+            O_WRONLY | O_CREAT | O_APPEND | O_CLOEXEC, MODE
+        );
+        break;
+      case Kind::DUPLICATE:
+        // Refers to the descriptor as left by the actions before, so
+        // `>file 2>&1` sends both to `file`
+        if (auto const fd = parse_fd(redirection.target)) {
+          actions.push_back({redirection.fd, fd.value()});
+          continue;
+        }
+        Log::error(
+            "Bad file descriptor in redirection: \"{}\"", redirection.target
+        );
+        return false;
+      case Kind::HERE_DOCUMENT:
+      case Kind::HERE_STRING:
+        source = seal_content(redirection.content);
+        break;
+      }
+
+      if (source == -1) {
+        Log::error(
+            "Could not redirect to \"{}\": {}", redirection.target,
+            std::strerror(errno)
+        );
+        return false;
+      }
+      source = above(source, highest);
+      if (source == -1) {
+        Log::error(
+            "Could not redirect to \"{}\": {}", redirection.target,
+            std::strerror(errno)
+        );
+        return false;
+      }
+      actions.push_back({redirection.fd, descriptors.own(source)});
+    }
+    return true;
+  }
+
+  // Forks and executes `argv` after applying `actions` in the child, through
+  // the fork server when it is running. The child's pid is -1 when forking
+  // failed, which may only be temporary
+  auto spawn(
+      std::vector<std::string> const& argv, std::vector<Action> const& actions
+  ) -> ForkServer::Child {
+    std::vector<char const*> c_argv{};
+    c_argv.reserve(argv.size() + 1);
+    std::ranges::transform(
+        argv, std::back_inserter(c_argv), &std::string::c_str
+    );
+    c_argv.push_back(nullptr);
+    // Kept alive until the child replaced its image
+    auto const environment = Environment::global().block();
+    // Keeps earlier messages ahead of the child's output
+    Log::flush();
+
+    if (ForkServer::running()) {
+      auto const child =
+          ForkServer::spawn(c_argv.data(), environment->envp.data(), actions);
+      if (child.pid != -1) {
+        return child;
+      }
+      Log::warn("The fork server failed, forking directly from now on");
+      ForkServer::stop();
+    }
+
+    auto const child_pid = fork();
+
+    switch (child_pid) {
+    case -1:
+      [[unlikely]] Log::error(
+          "Could not fork. Computer resources might limited. "
+          "Please try again later."
+      );
+      return {};
+    case 0:
+      if (!ForkServer::apply(actions)) {
+        Log::write_now(Log::Level::ERROR, "Could not set up redirections");
+        _exit(EX_OSERR);
+      }
+      execvpe(
+          c_argv[0], const_cast<char* const*>(c_argv.data()),
+          const_cast<char* const*>(environment->envp.data())
+      );
+      // The writer thread does not survive `fork` and leaving through `exit`
+      // would run the shell's exit handlers in the child
+      Log::write_now(
+          Log::Level::ERROR, "Could not execute the specified command"
+      );
+      _exit(EX_UNAVAILABLE);
+    default:
+      return {.pid = child_pid};
+    }
+  }
+
+  // Whether the fork server already reaped `child`, after which its pid may
+  // belong to another process. Direct children stay around until waited for
+  auto reaped(ForkServer::Child const child) -> bool {
+    if (child.reply == -1) {
+      return false;
+    }
+    pollfd reply{.fd = child.reply, .events = POLLIN, .revents = 0};
+    return poll(&reply, 1, 0) == 1;
+  }
+
+  auto microseconds(timeval const& time) -> std::chrono::microseconds {
+    return std::chrono::seconds{time.tv_sec} +
+           std::chrono::microseconds{time.tv_usec};
+  }
+
+  // Reaps the child and records its resource usage under `command`, wall
+  // time is measured from `start`
+  auto wait(
+      ForkServer::Child const child, Clock::time_point const start,
+      std::string_view const command
+  ) -> Stats::Usage {
+    rusage usage{};
+    if (child.reply != -1) {
+      usage = ForkServer::wait(child).usage;
+    } else {
+      while (wait4(child.pid, nullptr, 0, &usage) == -1 && errno == EINTR) {
+      }
+    }
+    Stats::Usage const result{
+        .wall = std::chrono::duration_cast<std::chrono::microseconds>(
+            Clock::now() - start
+        ),
+        .user = microseconds(usage.ru_utime),
+        .system = microseconds(usage.ru_stime),
+        .max_rss = static_cast<uint64_t>(usage.ru_maxrss),
+        .voluntary_switches = static_cast<uint64_t>(usage.ru_nvcsw),
+        .involuntary_switches = static_cast<uint64_t>(usage.ru_nivcsw),
+    };
+    Stats::record(command, result);
+    return result;
+  }
+
+  // Reads until EOF straight into the string's storage, growing it
+  // geometrically so large outputs need few reads and reallocations. Small
+  // outputs give back what they did not use, many of them may be kept
+  auto read_all(int const fd) -> std::string {
+    std::string data{};
+    for (;;) {
+      if (data.capacity() - data.size() < MIN_READ) {
+        data.reserve(std::max<size_t>(data.capacity() * 2, MIN_READ));
+      }
+      ssize_t received = 0;
+      auto const used = data.size();
+      data.resize_and_overwrite(
+          data.capacity(),
+          [fd, used, &received](char* buffer, size_t const size) {
+            received = read(fd, buffer + used, size - used);
+            return used + static_cast<size_t>(std::max<ssize_t>(received, 0));
+          }
+      );
+      if (received == 0 || (received == -1 && errno != EINTR)) {
+        break;
+      }
+    }
+    if (data.size() < MIN_READ) {
+      data.shrink_to_fit();
+    }
+    return data;
+  }
+
+  // Reads a redirection operator at the start of `rest`, returning its kind
+  // and length
+  auto read_operator(std::string_view const rest
+  ) -> std::pair<Redirection::Kind, size_t> {
+    using Kind = Redirection::Kind;
+    if (rest.starts_with("<<<")) {
+      return {Kind::HERE_STRING, 3};
+    }
+    if (rest.starts_with("<<")) {
+      return {Kind::HERE_DOCUMENT, 2};
+    }
+    if (rest.starts_with(">>")) {
+      return {Kind::APPEND, 2};
+    }
+    if (rest.starts_with(">&") || rest.starts_with("<&")) {
+      return {Kind::DUPLICATE, 2};
+    }
+    if (rest.starts_with(">")) {
+      return {Kind::OUTPUT, 1};
+    }
+    return {Kind::INPUT, 1};
+  }
+
+  // `NAME=value` definition, returning the position of `=`
+  auto find_assignment(std::string_view const word) -> size_t {
+    auto const separator = word.find('=');
+    if (separator == 0 || separator == std::string_view::npos ||
+        std::isdigit(static_cast<unsigned char>(word[0])) ||
+        !std::ranges::all_of(word.substr(0, separator), [](char const let) {
+          return std::isalnum(static_cast<unsigned char>(let)) || let == '_';
+        })) {
+      return std::string_view::npos;
+    }
+    return separator;
+  }
+
+  // Commands changing the shell's own state. Returns false for anything else
+  auto run_builtin(std::vector<std::string> const& argv) -> bool {
+    auto& environment = Environment::global();
+    auto const& name = argv.front();
+
+    if (name == "export") {
+      for (std::string_view const word : argv | std::views::drop(1)) {
+        auto const separator = find_assignment(word);
+        if (separator != std::string_view::npos) {
+          environment.set(
+              word.substr(0, separator), std::string{word.substr(separator + 1)}
+          );
+        }
+        environment.export_variable(word.substr(0, separator));
+      }
+      return true;
+    }
+    if (name == "unset") {
+      for (auto const& word : argv | std::views::drop(1)) {
+        environment.unset(word);
+      }
+      return true;
+    }
+    if (auto const separator = find_assignment(name);
+        argv.size() == 1 && separator != std::string_view::npos) {
+      environment.set(name.substr(0, separator), name.substr(separator + 1));
+      return true;
+    }
+    return false;
+  }
+
+  // Runs a builtin or spawns and waits for a command. Builtins only report
+  // their wall time
+  auto run(Command::Invocation const& invocation) -> Stats::Usage {
+    auto const start = Clock::now();
+    if (invocation.argv.empty() || run_builtin(invocation.argv)) {
+      return {
+          .wall = std::chrono::duration_cast<std::chrono::microseconds>(
+              Clock::now() - start
+          )
+      };
+    }
+    Descriptors descriptors{};
+    std::vector<Action> actions{};
+    if (!resolve(invocation.redirections, descriptors, actions)) {
+      return {};
+    }
+    auto const child = spawn(invocation.argv, actions);
+    if (child.pid == -1) {
+      return {};
+    }
+    return wait(child, start, invocation.argv.front());
+  }
+
+  // Name of the variable referenced by `NAME` or `{NAME}` at the start of
+  // `rest`, along with the number of characters taken
+  auto read_variable_name(std::string_view const rest
+  ) -> std::pair<std::string_view, size_t> {
+    auto const is_name = [](char const let) {
+      return std::isalnum(static_cast<unsigned char>(let)) || let == '_';
+    };
+    if (rest.starts_with('{')) {
+      auto const end = rest.find('}');
+      if (end == std::string_view::npos) {
+        return {};
+      }
+      return {rest.substr(1, end - 1), end + 1};
+    }
+    if (rest.empty() || std::isdigit(static_cast<unsigned char>(rest[0]))) {
+      return {};
+    }
+    auto const end = std::ranges::find_if_not(rest, is_name) - rest.begin();
+    auto const length = static_cast<size_t>(end);
+    return {rest.substr(0, length), length};
+  }
+} // namespace
+
+namespace Command {
+  struct Stream::State {
+    State() = default;
+    State(State const&) = delete;
+    auto operator=(State const&) -> State& = delete;
+
+    // The command gets SIGPIPE on its next write, but might not write again
+    // for a while (e.g. `tail -f`), so it is terminated right away
+    ~State() {
+      if (fd != -1) {
+        close(fd);
+      }
+      if (child.pid == -1) {
+        return;
+      }
+      if (!ended && !reaped(child)) {
+        kill(child.pid, SIGTERM);
+      }
+      wait(child, start, command);
+    }
+
+    // Drops the consumed lines and appends a single read
+    auto fill() -> void {
+      buffer.erase(0, begin);
+      scanned -= begin;
+      begin = 0;
+
+      ssize_t received = 0;
+      auto const used = buffer.size();
+      buffer.resize_and_overwrite(
+          used + MIN_READ,
+          [this, used, &received](char* data, size_t const size) {
+            received = read(fd, data + used, size - used);
+            return used + static_cast<size_t>(std::max<ssize_t>(received, 0));
+          }
+      );
+      if (received == 0 || (received == -1 && errno != EINTR)) {
+        ended = true;
+      }
+    }
+
+    int fd = -1;
+    ForkServer::Child child{};
+    Clock::time_point start{};
+    std::string command{};
+    std::string buffer{};
+    // Start of the unconsumed data and how far it was searched for newlines
+    size_t begin = 0;
+    size_t scanned = 0;
+    bool ended = false;
+  };
+
+  Stream::Stream(std::unique_ptr<State> state) : state_(std::move(state)) {}
+  Stream::Stream(Stream&&) noexcept = default;
+  auto Stream::operator=(Stream&&) noexcept -> Stream& = default;
+  Stream::~Stream() = default;
+
+  [[nodiscard]] auto Stream::next_line() -> std::optional<std::string_view> {
+    auto& state = *state_;
+    for (;;) {
+      auto const newline = state.buffer.find('\n', state.scanned);
+      if (newline != std::string::npos) {
+        auto const line = std::string_view{state.buffer}.substr(
+            state.begin, newline - state.begin
+        );
+        state.begin = state.scanned = newline + 1;
+        return line;
+      }
+      state.scanned = state.buffer.size();
+      if (state.ended) {
+        // Output not ending with a newline
+        if (state.begin == state.buffer.size()) {
+          return std::nullopt;
+        }
+        auto const line = std::string_view{state.buffer}.substr(state.begin);
+        state.begin = state.buffer.size();
+        return line;
+      }
+      state.fill();
+    }
+  }
+
+  [[nodiscard]] auto parse(std::string_view const line) -> Invocation {
+    Invocation invocation{};
+    std::string word{};
+    // Redirection waiting for its target, which is the next word
+    std::optional<Redirection> pending{};
+    // Shared by all arguments, e.g. `*.cpp *.hpp` reads the directory once
+    Glob::Cache cache{};
+
+    auto const flush = [&invocation, &word, &pending, &cache] {
+      if (word.empty()) {
+        return;
+      }
+      if (pending) {
+        if (pending->kind == Redirection::Kind::HERE_STRING) {
+          pending->content = word + '\n';
+        }
+        pending->target = std::move(word);
+        invocation.redirections.push_back(std::move(pending.value()));
+        pending.reset();
+      } else if (auto paths = Glob::has_pattern(word)
+                                  ? Glob::expand(word, cache)
+                                  : std::vector<std::string>{};
+                 !paths.empty()) {
+        std::ranges::move(paths, std::back_inserter(invocation.argv));
+      } else {
+        // Patterns without matches are passed on unchanged
+        invocation.argv.push_back(std::move(word));
+      }
+      word.clear();
+    };
+
+    // Unquoted expansions are split into separate arguments. The first and
+    // last fields stick to the surrounding text
+    auto const append_fields = [&word, &flush](std::string_view const text) {
+      auto separated = false;
+      for (auto const let : text) {
+        if (let == ' ' || let == '\t' || let == '\n') {
+          separated = true;
+          continue;
+        }
+        if (separated) {
+          flush();
+          separated = false;
+        }
+        word += let;
+      }
+    };
+
+    for (size_t pos = 0; pos < line.size(); ++pos) {
+      if (line[pos] == ' ') {
+        flush();
+        continue;
+      }
+      if (line[pos] == '<' || line[pos] == '>') {
+        auto const [kind, length] = read_operator(line.substr(pos));
+        auto fd = line[pos] == '<' ? STDIN_FILENO : STDOUT_FILENO;
+        // `2>file` redirects descriptor 2, `a>file` passes `a` as an argument
+        if (!word.empty() && std::ranges::all_of(word, [](char const let) {
+              return std::isdigit(static_cast<unsigned char>(let));
+            })) {
+          auto const prefix = parse_fd(word);
+          if (!prefix) {
+            Log::error("Bad file descriptor in redirection: \"{}\"", word);
+            return {};
+          }
+          fd = prefix.value();
+          word.clear();
+        }
+        flush();
+        pending =
+            Redirection{.kind = kind, .fd = fd, .target = {}, .content = {}};
+        pos += length - 1;
+        continue;
+      }
+      if (line[pos] != '$') {
+        word += line[pos];
+        continue;
+      }
+
+      if (line.substr(pos).starts_with("$(")) {
+        auto const begin = pos + 2;
+        auto depth = 1U;
+        for (pos = begin; pos < line.size(); ++pos) {
+          depth += static_cast<unsigned>(line[pos] == '(');
+          depth -= static_cast<unsigned>(line[pos] == ')');
+          if (depth == 0) {
+            break;
+          }
+        }
+        // Worded like the lexer's error for the same input
+        if (depth != 0) {
+          throw std::logic_error("Syntax error at end of input: missing )");
+        }
+        if (auto const output = capture(line.substr(begin, pos - begin))) {
+          append_fields(output->trimmed());
+        }
+        continue;
+      }
+
+      auto const [name, length] = read_variable_name(line.substr(pos + 1));
+      if (name.empty()) {
+        word += line[pos];
+        continue;
+      }
+      if (auto const value = Environment::global().get(name)) {
+        append_fields(value.value());
+      }
+      pos += length;
+    }
+    flush();
+    if (pending) {
+      Log::error("Missing redirection target");
+      return {};
+    }
+
+    return invocation;
+  }
+
+  auto execute(Invocation const& invocation) -> void {
+    if (invocation.argv.empty() || invocation.argv.front() != "time") {
+      run(invocation);
+      return;
+    }
+
+    // `time` applies to the rest of the command line, redirections included
+    Invocation timed{
+        .argv = {std::next(invocation.argv.begin()), invocation.argv.end()},
+        .redirections = invocation.redirections,
+    };
+    auto const usage = run(timed);
+    auto const seconds = [](std::chrono::microseconds const duration) {
+      return std::chrono::duration<double>{duration}.count();
+    };
+    fmt::print(
+        stderr,
+        "\nreal\t{:.3f}s\nuser\t{:.3f}s\nsys\t{:.3f}s\nmax rss\t{} KiB\n"
+        "switches\t{} voluntary, {} involuntary\n",
+        seconds(usage.wall), seconds(usage.user), seconds(usage.system),
+        usage.max_rss, usage.voluntary_switches, usage.involuntary_switches
+    );
+  }
+
+  auto execute(std::string_view const line) -> void { execute(parse(line)); }
+
+  [[nodiscard]] auto capture(std::string_view const line
+  ) -> std::optional<Output> {
+    auto const invocation = parse(line);
+    if (invocation.argv.empty()) {
+      return Output{""};
+    }
+
+    std::array<int, 2> fds{};
+    if (pipe2(fds.data(), O_CLOEXEC) == -1) {
+      Log::error("Could not create a pipe for command substitution");
+      return std::nullopt;
+    }
+    // Best effort, the default capacity is kept when the limit is lower
+    fcntl(fds[1], F_SETPIPE_SZ, PIPE_SIZE);
+
+    Descriptors descriptors{};
+    descriptors.own(fds[0]);
+    // Redirections of the substituted command apply on top of the pipe
+    std::vector<Action> actions{{STDOUT_FILENO, fds[1]}};
+    if (!resolve(invocation.redirections, descriptors, actions)) {
+      close(fds[1]);
+      return std::nullopt;
+    }
+
+    auto const start = Clock::now();
+    auto const child = spawn(invocation.argv, actions);
+    close(fds[1]);
+    if (child.pid == -1) {
+      return std::nullopt;
+    }
+    auto data = read_all(fds[0]);
+    wait(child, start, invocation.argv.front());
+
+    return Output{std::move(data)};
+  }
+
+  [[nodiscard]] auto stream(std::string_view const line
+  ) -> std::optional<Stream> {
+    auto const invocation = parse(line);
+    auto state = std::make_unique<Stream::State>();
+    if (invocation.argv.empty()) {
+      state->ended = true;
+      return Stream{std::move(state)};
+    }
+
+    std::array<int, 2> fds{};
+    if (pipe2(fds.data(), O_CLOEXEC) == -1) {
+      Log::error("Could not create a pipe for command substitution");
+      return std::nullopt;
+    }
+    state->fd = fds[0];
+    fcntl(fds[1], F_SETPIPE_SZ, PIPE_SIZE);
+
+    Descriptors descriptors{};
+    std::vector<Action> actions{{STDOUT_FILENO, fds[1]}};
+    if (!resolve(invocation.redirections, descriptors, actions)) {
+      close(fds[1]);
+      return std::nullopt;
+    }
+
+    state->start = Clock::now();
+    state->command = invocation.argv.front();
+    state->child = spawn(invocation.argv, actions);
+    close(fds[1]);
+    if (state->child.pid == -1) {
+      return std::nullopt;
+    }
+    return Stream{std::move(state)};
+  }
+} // namespace Command
@@ -1,54 +1,101 @@
 #pragma once
-#include "Log.hpp"
 
-#include <algorithm>
-#include <array>
+#include <memory>
+#include <optional>
 #include <ranges>
 #include <string>
 #include <string_view>
 #include <vector>
 
-#include <sys/wait.h>
-#include <sysexits.h>
-#include <unistd.h>
-
 namespace Command {
-  auto execute(std::string_view const line) -> void {
-    static constexpr auto MAX_ARGS = 1 << 8;
-
-    // Arguments ownership holder
-    std::vector<std::string> argv{};
-    std::array<char const*, MAX_ARGS> c_argv{0};
-
-    std::ranges::for_each(
-        std::ranges::views::split(line, ' '),
-        [&argv](auto const& arg) {
-          argv.emplace_back(std::string{arg.begin(), arg.end()});
-        }
-    );
-
-    for (auto i = 0U; i < argv.size(); ++i) {
-      c_argv[i] = argv[i].c_str();
-    }
+  // Standard output of a finished command. The bytes are read straight into
+  // the owned buffer, views returned from here stay valid while it lives
+  class Output {
+  public:
+    inline explicit Output(std::string data) : data_(std::move(data)) {}
 
-    auto const child_pid = fork();
+    [[nodiscard]] inline auto text() const -> std::string_view { return data_; }
 
-    switch (child_pid) {
-    case -1:
-      [[unlikely]] Log::error(
-          "Could not fork. Computer resources might limited. "
-          "Please try again later."
+    // Trailing newlines stripped, as done for shell command substitution
+    [[nodiscard]] inline auto trimmed() const -> std::string_view {
+      auto const end = data_.find_last_not_of('\n');
+      return std::string_view{data_}.substr(
+          0, end == std::string::npos ? 0 : end + 1
       );
-      std::exit(EX_OSERR);
-      break;
-    case 0:
-      if (execvp(argv[0].c_str(), const_cast<char* const*>(c_argv.data())) ==
-          -1) {
-        Log::error("Could not execute the specified command");
-      }
-      break;
-    default:
-      waitpid(child_pid, nullptr, 0);
     }
-  }
+
+    // Lines are produced lazily while iterating, nothing is copied
+    [[nodiscard]] inline auto lines() const {
+      return std::views::split(trimmed(), '\n') |
+             std::views::transform([](auto const& line) {
+               return std::string_view{line.begin(), line.end()};
+             });
+    }
+
+    [[nodiscard]] inline auto release() && -> std::string {
+      return std::move(data_);
+    }
+
+  private:
+    std::string data_;
+  };
+
+  // Standard output of a running command, split into lines as it arrives.
+  // Only a partial line and a single read are buffered, so memory use does
+  // not depend on the size of the output. Destroying the stream before the
+  // output ended stops the command
+  class Stream {
+  public:
+    struct State;
+
+    explicit Stream(std::unique_ptr<State> state);
+    Stream(Stream&&) noexcept;
+    auto operator=(Stream&&) noexcept -> Stream&;
+    ~Stream();
+
+    // Next line without its newline, valid until the following call.
+    // `std::nullopt` once the command closed its output
+    [[nodiscard]] auto next_line() -> std::optional<std::string_view>;
+
+  private:
+    std::unique_ptr<State> state_;
+  };
+
+  struct Redirection {
+    enum class Kind {
+      INPUT,         // <
+      OUTPUT,        // >
+      APPEND,        // >>
+      DUPLICATE,     // >& or <&
+      HERE_DOCUMENT, // <<
+      HERE_STRING,   // <<<
+    };
+
+    Kind kind;
+    // Descriptor of the child being redirected
+    int fd;
+    // File name, duplicated descriptor or here-document delimiter
+    std::string target;
+    // Data fed to the child by here-documents and here-strings. Here-document
+    // bodies are filled in by whoever reads the following lines
+    std::string content;
+  };
+
+  struct Invocation {
+    std::vector<std::string> argv;
+    std::vector<Redirection> redirections;
+  };
+
+  // Splits a command line into arguments and redirections, expanding `$(...)`
+  // substitutions. Throws `std::logic_error` holding the syntax error when a
+  // substitution is not closed, as do the functions taking a line below
+  [[nodiscard]] auto parse(std::string_view line) -> Invocation;
+
+  auto execute(Invocation const& invocation) -> void;
+  auto execute(std::string_view line) -> void;
+
+  // Runs `line` and collects everything it writes to stdout
+  [[nodiscard]] auto capture(std::string_view line) -> std::optional<Output>;
+  // Starts `line` and returns its stdout without waiting for it to finish
+  [[nodiscard]] auto stream(std::string_view line) -> std::optional<Stream>;
 } // namespace Command
@@ -0,0 +1,140 @@
+#include "Environment.hpp"
+
+#include <cstdlib>
+#include <mutex>
+
+#include <unistd.h>
+
+[[nodiscard]] auto Environment::global() -> Environment& {
+  static auto& environment = []() -> Environment& {
+    // Never destroyed, background threads may still spawn during exit
+    auto* instance = new Environment{};
+    for (auto** entry = environ; *entry != nullptr; ++entry) {
+      std::string_view const definition{*entry};
+      auto const separator = definition.find('=');
+      if (separator == std::string_view::npos) {
+        continue;
+      }
+      auto& variable =
+          instance->find_or_insert(definition.substr(0, separator));
+      variable.value_ = definition.substr(separator + 1);
+      variable.exported_ = true;
+    }
+    return *instance;
+  }();
+  return environment;
+}
+
+[[nodiscard]] auto Environment::resolve(std::string_view const name
+) -> Reference {
+  {
+    std::shared_lock const lock{mutex_};
+    if (auto const found = variables_.find(std::string{name});
+        found != variables_.end()) {
+      return &found->second;
+    }
+  }
+  std::unique_lock const lock{mutex_};
+  return &find_or_insert(name);
+}
+
+[[nodiscard]] auto Environment::get(Reference const variable
+) const -> std::optional<std::string> {
+  std::shared_lock const lock{mutex_};
+  return variable->value_;
+}
+
+[[nodiscard]] auto Environment::get(std::string_view const name
+) -> std::optional<std::string> {
+  return get(resolve(name));
+}
+
+auto Environment::set(std::string_view const name, std::string value) -> void {
+  std::unique_lock const lock{mutex_};
+  auto& variable = find_or_insert(name);
+  variable.value_ = std::move(value);
+  if (variable.exported_) {
+    ++generation_;
+    synchronize(variable);
+  }
+}
+
+auto Environment::export_variable(std::string_view const name) -> void {
+  std::unique_lock const lock{mutex_};
+  auto& variable = find_or_insert(name);
+  if (!variable.exported_) {
+    variable.exported_ = true;
+    ++generation_;
+    synchronize(variable);
+  }
+}
+
+auto Environment::unset(std::string_view const name) -> void {
+  std::unique_lock const lock{mutex_};
+  auto& variable = find_or_insert(name);
+  if (variable.exported_ && variable.value_) {
+    ++generation_;
+  }
+  variable.value_.reset();
+  variable.exported_ = false;
+  synchronize(variable);
+}
+
+[[nodiscard]] auto Environment::block() -> std::shared_ptr<Block const> {
+  {
+    std::shared_lock const lock{mutex_};
+    if (block_ && block_->generation == generation_) {
+      return block_;
+    }
+  }
+
+  std::unique_lock const lock{mutex_};
+  // Another thread might have rebuilt it in the meantime
+  if (block_ && block_->generation == generation_) {
+    return block_;
+  }
+
+  auto block = std::make_shared<Block>();
+  block->generation = generation_;
+  std::vector<size_t> offsets{};
+  for (auto const& [name, variable] : variables_) {
+    if (!variable.exported_ || !variable.value_) {
+      continue;
+    }
+    offsets.push_back(block->data.size());
+    block->data.append(name);
+    block->data += '=';
+    block->data.append(variable.value_.value());
+    block->data += '\0';
+  }
+  // Pointers are taken once `data` stopped growing
+  block->envp.reserve(offsets.size() + 1);
+  for (auto const offset : offsets) {
+    block->envp.push_back(block->data.data() + offset);
+  }
+  block->envp.push_back(nullptr);
+
+  block_ = std::move(block);
+  return block_;
+}
+
+auto Environment::find_or_insert(std::string_view const name) -> Variable& {
+  auto [found, inserted] = variables_.try_emplace(std::string{name});
+  if (inserted) {
+    found->second.name_ = name;
+  }
+  return found->second;
+}
+
+// `execvpe` searches the PATH of the calling process rather than the one in
+// `envp`
+auto Environment::synchronize(Variable const& variable) -> void {
+  if (variable.name_ != "PATH") {
+    return;
+  }
+  if (variable.exported_ && variable.value_) {
+    setenv("PATH", variable.value_->c_str(), 1);
+  } else {
+    unsetenv("PATH");
+  }
+}
@@ -0,0 +1,68 @@
+#pragma once
+
+#include <cstdint>
+#include <memory>
+#include <optional>
+#include <shared_mutex>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+#include <vector>
+
+// Shell variables. Exported ones are passed to spawned commands through a
+// prebuilt `envp` block which is only rebuilt after an exported variable
+// changes. Blocks are immutable, so concurrent spawns share one block and
+// keep using it even while a newer one is being built (copy-on-write)
+class Environment {
+public:
+  class Variable {
+  public:
+    [[nodiscard]] inline auto name() const -> std::string_view { return name_; }
+
+  private:
+    friend class Environment;
+    std::string name_;
+    std::optional<std::string> value_;
+    bool exported_ = false;
+  };
+
+  // Resolved once (e.g. while parsing) and valid for the lifetime of the
+  // environment, even after the variable is unset
+  using Reference = Variable const*;
+
+  struct Block {
+    // `NAME=value\0` strings stored back to back
+    std::string data;
+    // Null terminated pointers into `data`
+    std::vector<char const*> envp;
+    uint64_t generation;
+  };
+
+  // The shell's environment, initialized from `environ`
+  [[nodiscard]] static auto global() -> Environment&;
+
+  [[nodiscard]] auto resolve(std::string_view name) -> Reference;
+  [[nodiscard]] auto get(Reference variable) const
+      -> std::optional<std::string>;
+  [[nodiscard]] auto get(std::string_view name) -> std::optional<std::string>;
+
+  auto set(std::string_view name, std::string value) -> void;
+  auto export_variable(std::string_view name) -> void;
+  auto unset(std::string_view name) -> void;
+
+  [[nodiscard]] auto block() -> std::shared_ptr<Block const>;
+
+private:
+  Environment() = default;
+
+  auto find_or_insert(std::string_view name) -> Variable&;
+  // Mirrors variables which affect the shell process itself
+  static auto synchronize(Variable const& variable) -> void;
+
+  mutable std::shared_mutex mutex_;
+  // Node based, so references survive rehashing
+  std::unordered_map<std::string, Variable> variables_;
+  // Bumped whenever the exported set changes
+  uint64_t generation_ = 1;
+  std::shared_ptr<Block const> block_;
+};
@@ -1,8 +1,12 @@
 #pragma once
 #include <fmt/core.h>
 #include <memory>
+#include <optional>
+#include <string_view>
 #include <variant>
+#include <vector>
 
+#include "Environment.hpp"
 #include "Token.hpp"
 
 template <class... Ts> struct overloads : Ts... {
@@ -18,6 +22,14 @@ namespace Expr {
   struct Grouping;
   struct Unary;
   struct Binary;
+  struct Substitution;
+  struct Variable;
+  struct Array;
+  struct Call;
+  struct Local;
+  struct For;
+  struct Break;
+  struct Print;
 
   // Might be a good idea forcing explicit `make_shared` calls instead of hiding
   // heap allocation inside the expression interfaces
@@ -25,9 +37,39 @@ namespace Expr {
   using GroupingPtr = std::shared_ptr<Grouping>;
   using UnaryPtr = std::shared_ptr<Unary>;
   using BinaryPtr = std::shared_ptr<Binary>;
+  using SubstitutionPtr = std::shared_ptr<Substitution>;
+  using VariablePtr = std::shared_ptr<Variable>;
+  using ArrayPtr = std::shared_ptr<Array>;
+  using CallPtr = std::shared_ptr<Call>;
+  using LocalPtr = std::shared_ptr<Local>;
+  using ForPtr = std::shared_ptr<For>;
+  using BreakPtr = std::shared_ptr<Break>;
+  using PrintPtr = std::shared_ptr<Print>;
 
   // TODO: Move Ptr types to `detail`?
-  using T = std::variant<LiteralPtr, BinaryPtr, UnaryPtr, GroupingPtr>;
+  using T = std::variant<
+      LiteralPtr, BinaryPtr, UnaryPtr, GroupingPtr, SubstitutionPtr,
+      VariablePtr, ArrayPtr, CallPtr, LocalPtr, ForPtr, BreakPtr, PrintPtr>;
+
+  // Binary operations whose operand types are known before evaluation, set by
+  // `Typing::infer`. `GENERIC` operations check their operands at runtime
+  enum class Specialization : uint8_t {
+    GENERIC,
+    NUMBER_ADD,
+    NUMBER_SUBTRACT,
+    NUMBER_MULTIPLY,
+    NUMBER_DIVIDE,
+    NUMBER_MODULO,
+    NUMBER_GREATER,
+    NUMBER_GREATER_EQUAL,
+    NUMBER_LESS,
+    NUMBER_LESS_EQUAL,
+    NUMBER_EQUAL,
+    NUMBER_NOT_EQUAL,
+    STRING_CONCATENATE,
+    STRING_EQUAL,
+    STRING_NOT_EQUAL,
+  };
 
   // TODO: Make Literal consistent with the others? or should terminal
   // expressions not have `init` as an initialization option
@@ -40,27 +82,69 @@ namespace Expr {
     }
   };
 
+  namespace detail {
+    // Operators can be nested arbitrarily deep, e.g. a long chain of `+`, so
+    // destroying one must not recurse into its operands. Operands destroyed
+    // along with their operator are handed over to the list of the outermost
+    // destructor instead, which destroys them one at a time
+    inline auto release(T& operand) -> void {
+      // Not an owning `thread_local`, trees may outlive it at exit
+      thread_local std::vector<T>* released = nullptr;
+
+      auto const last_owner = std::visit(
+          overloads{
+              [](GroupingPtr const& node) { return node.use_count() == 1; },
+              [](UnaryPtr const& node) { return node.use_count() == 1; },
+              [](BinaryPtr const& node) { return node.use_count() == 1; },
+              [](auto const&) { return false; }
+          },
+          operand
+      );
+      if (!last_owner) {
+        return;
+      }
+      if (released != nullptr) {
+        released->push_back(std::move(operand));
+        return;
+      }
+
+      std::vector<T> pending{};
+      pending.push_back(std::move(operand));
+      released = &pending;
+      while (!pending.empty()) {
+        // Destroyed at the end of the iteration, which may release more
+        auto const next = std::move(pending.back());
+        pending.pop_back();
+      }
+      released = nullptr;
+    }
+  } // namespace detail
+
   struct Grouping {
     // `detail::Grouping` can just be referred as `Grouping` but might cause
     // misunderstanding
     T expression;
+
+    ~Grouping() { detail::release(expression); }
+
     static inline auto init(T expression) -> std::shared_ptr<Grouping> {
-      // TODO: Check if copy constructed by using aggregate initialization
-      return std::make_shared<Grouping>(
-          Grouping{.expression = std::move(expression)}
-      );
+      return std::make_shared<Grouping>(std::move(expression));
     }
   };
 
   struct Unary {
     Token const operation;
     T expression;
+    // Memoization slot given to shared subexpressions, see `Interner`
+    std::optional<uint32_t> slot{};
+
+    ~Unary() { detail::release(expression); }
 
     static inline auto
     init(Token operation, T expression) -> std::shared_ptr<Unary> {
-      return std::make_shared<Unary>(Unary{
-          .operation = std::move(operation), .expression = std::move(expression)
-      });
+      return std::make_shared<Unary>(
+          std::move(operation), std::move(expression)
+      );
     }
   };
 
@@ -68,17 +152,158 @@ namespace Expr {
     T left;
     Token const operation;
     T right;
+    Specialization specialization = Specialization::GENERIC;
+    std::optional<uint32_t> slot{};
+
+    ~Binary() {
+      detail::release(left);
+      detail::release(right);
+    }
 
     static inline auto
     init(T left, Token operation, T right) -> std::shared_ptr<Binary> {
-      return std::make_shared<Binary>(Binary{
-          .left = std::move(left),
-          .operation = std::move(operation),
-          .right = std::move(right)
+      return std::make_shared<Binary>(
+          std::move(left), std::move(operation), std::move(right)
+      );
+    }
+  };
+
+  // Output of a command, `$(command)`. Runs the command on every evaluation
+  struct Substitution {
+    Token const command;
+
+    static inline auto init(Token command) -> std::shared_ptr<Substitution> {
+      return std::make_shared<Substitution>(std::move(command));
+    }
+  };
+
+  // Environment variable, `$NAME`. The variable is looked up once while
+  // parsing, evaluation reads it through the stored reference
+  struct Variable {
+    Token const name;
+    Environment::Reference const reference;
+
+    static inline auto init(Token name) -> std::shared_ptr<Variable> {
+      auto const reference = Environment::global().resolve(
+          std::get<std::string>(name.literal_.value())
+      );
+      return std::make_shared<Variable>(std::move(name), reference);
+    }
+  };
+
+  // `[first, second, ...]`, elements have to evaluate to numbers
+  struct Array {
+    Token const bracket;
+    std::vector<T> elements;
+
+    static inline auto init(Token bracket, std::vector<T> elements)
+        -> std::shared_ptr<Array> {
+      return std::make_shared<Array>(Array{
+          .bracket = std::move(bracket), .elements = std::move(elements)
+      });
+    }
+  };
+
+  // Built-in function applied to its arguments, e.g. `sum(values)`
+  struct Call {
+    enum class Builtin : uint8_t { SUM, MIN, MAX, LEN };
+
+    Token const callee;
+    Builtin const builtin;
+    std::vector<T> arguments;
+
+    static inline auto
+    init(Token callee, Builtin builtin, std::vector<T> arguments)
+        -> std::shared_ptr<Call> {
+      return std::make_shared<Call>(Call{
+          .callee = std::move(callee),
+          .builtin = builtin,
+          .arguments = std::move(arguments)
+      });
+    }
+  };
+
+  // Loop variable used inside the body of a `for` loop. `depth` is the number
+  // of loops around the one defining it, which is where the interpreter
+  // keeps its value
+  struct Local {
+    Token const name;
+    uint32_t const depth;
+
+    static inline auto init(Token name, uint32_t const depth)
+        -> std::shared_ptr<Local> {
+      return std::make_shared<Local>(std::move(name), depth);
+    }
+  };
+
+  // `for name in iterable begin body end`. The iterable is a range of
+  // numbers, `first..last` (both included), an array, or a command
+  // substitution whose output lines are read while the command runs.
+  // Evaluates to the number of iterations
+  struct For {
+    Token const keyword;
+    Token const name;
+    uint32_t const depth;
+    T iterable;
+    // End of the range when `iterable` is its start
+    std::optional<T> last;
+    std::vector<T> body;
+
+    static inline auto init(
+        Token keyword, Token name, uint32_t const depth, T iterable,
+        std::optional<T> last, std::vector<T> body
+    ) -> std::shared_ptr<For> {
+      return std::make_shared<For>(For{
+          .keyword = std::move(keyword),
+          .name = std::move(name),
+          .depth = depth,
+          .iterable = std::move(iterable),
+          .last = std::move(last),
+          .body = std::move(body)
       });
     }
   };
 
+  // `break` or `break if condition`. Only parsed as a statement of a loop
+  // body, leaving the innermost loop
+  struct Break {
+    Token const keyword;
+    std::optional<T> condition;
+
+    static inline auto init(Token keyword, std::optional<T> condition)
+        -> std::shared_ptr<Break> {
+      return std::make_shared<Break>(Break{
+          .keyword = std::move(keyword), .condition = std::move(condition)
+      });
+    }
+  };
+
+  // `print expression`, writes the value to stdout and evaluates to it
+  struct Print {
+    Token const keyword;
+    T expression;
+
+    static inline auto init(Token keyword, T expression)
+        -> std::shared_ptr<Print> {
+      return std::make_shared<Print>(Print{
+          .keyword = std::move(keyword), .expression = std::move(expression)
+      });
+    }
+  };
+
+  inline auto display(T const& expression) -> std::string;
+
+  inline auto display(
+      std::vector<T> const& expressions, std::string_view const separator = ", "
+  ) -> std::string {
+    std::string out{};
+    for (size_t i = 0; i < expressions.size(); ++i) {
+      out += i == 0 ? "" : separator;
+      out += display(expressions[i]);
+    }
+    return out;
+  }
+
   inline auto display(T const& expression) -> std::string {
     return std::visit(
         overloads{
@@ -97,6 +322,41 @@ namespace Expr {
                   "({} {} {})", expr->operation.display(), display(expr->left),
                   display(expr->right)
               );
+            },
+            [](SubstitutionPtr const& expr) {
+              return expr->command.display();
+            },
+            [](VariablePtr const& expr) { return expr->name.display(); },
+            [](ArrayPtr const& expr) -> std::string {
+              return fmt::format("[{}]", display(expr->elements));
+            },
+            [](CallPtr const& expr) -> std::string {
+              return fmt::format(
+                  "{}({})",
+                  std::get<std::string>(expr->callee.literal_.value()),
+                  display(expr->arguments)
+              );
+            },
+            [](LocalPtr const& expr) { return expr->name.display(); },
+            [](ForPtr const& expr) -> std::string {
+              return fmt::format(
+                  "(for {} in {}{} begin {} end)",
+                  std::get<std::string>(expr->name.literal_.value()),
+                  display(expr->iterable),
+                  expr->last ? ".." + display(expr->last.value()) : "",
+                  display(expr->body, "; ")
+              );
+            },
+            [](BreakPtr const& expr) -> std::string {
+              if (expr->condition) {
+                return fmt::format(
+                    "(break if {})", display(expr->condition.value())
+                );
+              }
+              return "break";
+            },
+            [](PrintPtr const& expr) -> std::string {
+              return fmt::format("(print {})", display(expr->expression));
             }
         },
         expression
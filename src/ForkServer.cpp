@@ -0,0 +1,478 @@
+#include "ForkServer.hpp"
+#include "Log.hpp"
+
+#include <algorithm>
+#include <array>
+#include <atomic>
+#include <cerrno>
+#include <csignal>
+#include <cstdint>
+#include <cstdlib>
+#include <cstring>
+#include <mutex>
+#include <string_view>
+#include <unordered_map>
+#include <vector>
+
+#include <fcntl.h>
+#include <poll.h>
+#include <sys/signalfd.h>
+#include <sys/socket.h>
+#include <sys/wait.h>
+#include <sysexits.h>
+#include <unistd.h>
+
+namespace {
+  using ForkServer::Action;
+
+  // Descriptors passed along with a single request, beyond the reply pipe
+  // and the working directory
+  constexpr size_t MAX_INHERITED = 64;
+  constexpr size_t MAX_FDS = MAX_INHERITED + 2;
+
+  struct Header {
+    // Bytes following the header
+    uint32_t size;
+    uint32_t argc;
+    uint32_t envc;
+    uint32_t actions;
+    uint32_t inherited;
+  };
+
+  // First message on the reply pipe, followed by `ForkServer::Exit` once the
+  // child was reaped
+  struct Started {
+    pid_t pid;
+    int error;
+  };
+
+  // Shell's end of the socket, -1 when the server is not running
+  std::atomic<int> control{-1};
+  // Requests are written in several parts which must not interleave
+  std::mutex sending{};
+
+  auto write_all(int const fd, void const* data, size_t size) -> bool {
+    auto const* bytes = static_cast<char const*>(data);
+    while (size != 0) {
+      auto const count = write(fd, bytes, size);
+      if (count == -1) {
+        if (errno == EINTR) {
+          continue;
+        }
+        return false;
+      }
+      bytes += count;
+      size -= static_cast<size_t>(count);
+    }
+    return true;
+  }
+
+  // Like `write_all` for the socket, without raising SIGPIPE in the shell
+  // when the helper is gone. That, `EPIPE` included, is a failed send
+  auto send_all(int const socket, void const* data, size_t size) -> bool {
+    auto const* bytes = static_cast<char const*>(data);
+    while (size != 0) {
+      auto const count = send(socket, bytes, size, MSG_NOSIGNAL);
+      if (count == -1) {
+        if (errno == EINTR) {
+          continue;
+        }
+        return false;
+      }
+      bytes += count;
+      size -= static_cast<size_t>(count);
+    }
+    return true;
+  }
+
+  // False on errors and when the other end was closed early
+  auto read_all(int const fd, void* data, size_t size) -> bool {
+    auto* bytes = static_cast<char*>(data);
+    while (size != 0) {
+      auto const count = read(fd, bytes, size);
+      if (count == -1 && errno == EINTR) {
+        continue;
+      }
+      if (count <= 0) {
+        return false;
+      }
+      bytes += count;
+      size -= static_cast<size_t>(count);
+    }
+    return true;
+  }
+
+  template <class T> auto append(std::vector<char>& out, T const& value) {
+    auto const* bytes = reinterpret_cast<char const*>(&value);
+    out.insert(out.end(), bytes, bytes + sizeof(T));
+  }
+
+  template <class T>
+  auto take(std::string_view& in, size_t const count) -> std::vector<T> {
+    std::vector<T> values(count);
+    auto const size = std::min(in.size(), count * sizeof(T));
+    std::memcpy(values.data(), in.data(), size);
+    in.remove_prefix(size);
+    return values;
+  }
+
+  // Splits `count` null terminated strings off the front of `in`
+  auto take_strings(std::string_view& in, size_t const count)
+      -> std::vector<char const*> {
+    std::vector<char const*> strings{};
+    strings.reserve(count + 1);
+    for (size_t i = 0; i < count && !in.empty(); ++i) {
+      strings.push_back(in.data());
+      in.remove_prefix(std::min(in.size(), std::strlen(in.data()) + 1));
+    }
+    strings.push_back(nullptr);
+    return strings;
+  }
+
+  // Runs in the helper's child: rebuilds the shell's descriptor table from
+  // the passed copies, then behaves like a direct spawn
+  [[noreturn]] auto
+  exec_child(std::string_view payload, Header const& header, int const* fds) {
+    sigset_t all{};
+    sigfillset(&all);
+    sigprocmask(SIG_UNBLOCK, &all, nullptr);
+    std::signal(SIGINT, SIG_DFL);
+    std::signal(SIGQUIT, SIG_DFL);
+
+    auto const actions = take<Action>(payload, header.actions);
+    auto const originals = take<int>(payload, header.inherited);
+    auto const argv = take_strings(payload, header.argc);
+    auto const envp = take_strings(payload, header.envc);
+
+    if (fchdir(fds[1]) == -1) {
+      Log::write_now(Log::Level::ERROR, "Could not enter the directory");
+      _exit(EX_OSERR);
+    }
+
+    // Received descriptors may sit at numbers about to be overwritten, so
+    // they are moved above everything first
+    auto floor = std::ranges::max(originals) + 1;
+    for (size_t i = 0; i < header.inherited + 2; ++i) {
+      floor = std::max(floor, fds[i] + 1);
+    }
+    std::array<int, MAX_INHERITED> moved{};
+    for (size_t i = 0; i < header.inherited; ++i) {
+      moved[i] = fcntl(fds[i + 2], F_DUPFD_CLOEXEC, floor);
+      if (moved[i] == -1) {
+        Log::write_now(Log::Level::ERROR, "Could not set up redirections");
+        _exit(EX_OSERR);
+      }
+    }
+    for (size_t i = 0; i < header.inherited; ++i) {
+      if (dup2(moved[i], originals[i]) == -1) {
+        Log::write_now(Log::Level::ERROR, "Could not set up redirections");
+        _exit(EX_OSERR);
+      }
+      // Descriptors beyond stdio were close-on-exec in the shell as well
+      if (originals[i] > STDERR_FILENO) {
+        fcntl(originals[i], F_SETFD, FD_CLOEXEC);
+      }
+    }
+
+    if (!ForkServer::apply(actions)) {
+      Log::write_now(Log::Level::ERROR, "Could not set up redirections");
+      _exit(EX_OSERR);
+    }
+
+    // `execvpe` searches the helper's own `PATH`, which might be outdated
+    auto const path = std::ranges::find_if(envp, [](char const* entry) {
+      return entry != nullptr && std::string_view{entry}.starts_with("PATH=");
+    });
+    if (path != envp.end() && *path != nullptr) {
+      setenv("PATH", *path + 5, 1);
+    } else {
+      unsetenv("PATH");
+    }
+
+    execvpe(
+        argv[0], const_cast<char* const*>(argv.data()),
+        const_cast<char* const*>(envp.data())
+    );
+    Log::write_now(
+        Log::Level::ERROR, "Could not execute the specified command"
+    );
+    _exit(EX_UNAVAILABLE);
+  }
+
+  // Reads a request and forks its child. Returns false once the shell closed
+  // its end
+  auto handle_request(
+      int const socket, std::unordered_map<pid_t, int>& replies
+  ) -> bool {
+    Header header{};
+    std::array<char, CMSG_SPACE(sizeof(int) * MAX_FDS)> control_buffer{};
+    iovec io{.iov_base = &header, .iov_len = sizeof(header)};
+    msghdr message{
+        .msg_name = nullptr,
+        .msg_namelen = 0,
+        .msg_iov = &io,
+        .msg_iovlen = 1,
+        .msg_control = control_buffer.data(),
+        .msg_controllen = control_buffer.size(),
+        .msg_flags = 0,
+    };
+    ssize_t received = 0;
+    do {
+      received = recvmsg(socket, &message, MSG_CMSG_CLOEXEC);
+    } while (received == -1 && errno == EINTR);
+    if (received <= 0) {
+      return false;
+    }
+
+    std::vector<int> fds{};
+    for (auto* cmsg = CMSG_FIRSTHDR(&message); cmsg != nullptr;
+         cmsg = CMSG_NXTHDR(&message, cmsg)) {
+      if (cmsg->cmsg_level == SOL_SOCKET && cmsg->cmsg_type == SCM_RIGHTS) {
+        auto const count = (cmsg->cmsg_len - CMSG_LEN(0)) / sizeof(int);
+        auto const begin = fds.size();
+        fds.resize(begin + count);
+        std::memcpy(&fds[begin], CMSG_DATA(cmsg), count * sizeof(int));
+      }
+    }
+    // A stream may deliver the header in parts
+    auto const rest = sizeof(header) - static_cast<size_t>(received);
+    std::vector<char> payload{};
+    auto complete =
+        read_all(socket, reinterpret_cast<char*>(&header) + received, rest);
+    if (complete) {
+      payload.resize(header.size);
+      complete = read_all(socket, payload.data(), payload.size());
+    }
+    if (!complete) {
+      std::ranges::for_each(fds, close);
+      return false;
+    }
+    if (fds.size() != header.inherited + 2) {
+      // Malformed request, the reply pipe (if any) reports the failure
+      if (!fds.empty()) {
+        Started const failed{.pid = -1, .error = EINVAL};
+        write_all(fds.front(), &failed, sizeof(failed));
+      }
+      std::ranges::for_each(fds, close);
+      return true;
+    }
+
+    auto const pid = fork();
+    if (pid == 0) {
+      exec_child({payload.data(), payload.size()}, header, fds.data());
+    }
+    Started const started{.pid = pid, .error = pid == -1 ? errno : 0};
+    auto const reply = fds.front();
+    std::for_each(fds.begin() + 1, fds.end(), close);
+    write_all(reply, &started, sizeof(started));
+    if (pid == -1) {
+      close(reply);
+    } else {
+      replies.emplace(pid, reply);
+    }
+    return true;
+  }
+
+  auto reap(std::unordered_map<pid_t, int>& replies) -> void {
+    for (;;) {
+      ForkServer::Exit exit{};
+      auto const pid = wait4(-1, &exit.status, WNOHANG, &exit.usage);
+      if (pid <= 0) {
+        return;
+      }
+      if (auto const found = replies.find(pid); found != replies.end()) {
+        write_all(found->second, &exit, sizeof(exit));
+        close(found->second);
+        replies.erase(found);
+      }
+    }
+  }
+
+  [[noreturn]] auto serve(int const socket) {
+    // Interrupting a foreground command must not take the helper along
+    std::signal(SIGINT, SIG_IGN);
+    std::signal(SIGQUIT, SIG_IGN);
+    sigset_t child{};
+    sigemptyset(&child);
+    sigaddset(&child, SIGCHLD);
+    sigprocmask(SIG_BLOCK, &child, nullptr);
+    auto const signals = signalfd(-1, &child, SFD_CLOEXEC);
+
+    std::unordered_map<pid_t, int> replies{};
+    std::array<pollfd, 2> events{
+        pollfd{.fd = socket, .events = POLLIN, .revents = 0},
+        pollfd{.fd = signals, .events = POLLIN, .revents = 0},
+    };
+    for (;;) {
+      if (poll(events.data(), events.size(), -1) == -1) {
+        continue;
+      }
+      if (events[1].revents != 0) {
+        signalfd_siginfo info{};
+        while (read(signals, &info, sizeof(info)) == -1 && errno == EINTR) {
+        }
+        reap(replies);
+      }
+      if (events[0].revents != 0 && !handle_request(socket, replies)) {
+        // Children still running report to nobody, they are reparented
+        _exit(EX_OK);
+      }
+    }
+  }
+} // namespace
+
+namespace ForkServer {
+  auto start() -> bool {
+    if (running()) {
+      return true;
+    }
+    std::array<int, 2> ends{};
+    if (socketpair(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0, ends.data()) ==
+        -1) {
+      return false;
+    }
+    switch (fork()) {
+    case -1:
+      close(ends[0]);
+      close(ends[1]);
+      return false;
+    case 0:
+      close(ends[0]);
+      serve(ends[1]);
+    default:
+      close(ends[1]);
+      control.store(ends[0]);
+      return true;
+    }
+  }
+
+  auto stop() -> void {
+    std::scoped_lock const lock{sending};
+    if (auto const socket = control.exchange(-1); socket != -1) {
+      close(socket);
+    }
+  }
+
+  [[nodiscard]] auto running() -> bool { return control.load() != -1; }
+
+  [[nodiscard]] auto spawn(
+      char const* const* const argv, char const* const* const envp,
+      std::span<Action const> const actions
+  ) -> Child {
+    // Descriptors the child inherits: stdio and every open action source
+    std::vector<int> inherited{STDIN_FILENO, STDOUT_FILENO, STDERR_FILENO};
+    for (auto const action : actions) {
+      if (std::ranges::find(inherited, action.source) == inherited.end() &&
+          fcntl(action.source, F_GETFD) != -1) {
+        inherited.push_back(action.source);
+      }
+    }
+    if (inherited.size() > MAX_INHERITED) {
+      return {};
+    }
+
+    std::vector<char> payload{};
+    for (auto const action : actions) {
+      append(payload, action);
+    }
+    for (auto const fd : inherited) {
+      append(payload, fd);
+    }
+    auto const append_strings = [&payload](char const* const* strings) {
+      uint32_t count = 0;
+      for (; strings[count] != nullptr; ++count) {
+        std::string_view const string{strings[count]};
+        payload.insert(payload.end(), string.begin(), string.end());
+        payload.push_back('\0');
+      }
+      return count;
+    };
+    auto const argc = append_strings(argv);
+    auto const envc = append_strings(envp);
+    Header header{
+        .size = static_cast<uint32_t>(payload.size()),
+        .argc = argc,
+        .envc = envc,
+        .actions = static_cast<uint32_t>(actions.size()),
+        .inherited = static_cast<uint32_t>(inherited.size()),
+    };
+
+    std::array<int, 2> reply{};
+    if (pipe2(reply.data(), O_CLOEXEC) == -1) {
+      return {};
+    }
+    auto const directory = open(".", O_PATH | O_DIRECTORY | O_CLOEXEC);
+    std::vector<int> fds{reply[1], directory};
+    fds.insert(fds.end(), inherited.begin(), inherited.end());
+
+    std::array<char, CMSG_SPACE(sizeof(int) * MAX_FDS)> control_buffer{};
+    iovec io{.iov_base = &header, .iov_len = sizeof(header)};
+    msghdr message{
+        .msg_name = nullptr,
+        .msg_namelen = 0,
+        .msg_iov = &io,
+        .msg_iovlen = 1,
+        .msg_control = control_buffer.data(),
+        .msg_controllen = CMSG_SPACE(sizeof(int) * fds.size()),
+        .msg_flags = 0,
+    };
+    auto* cmsg = CMSG_FIRSTHDR(&message);
+    cmsg->cmsg_level = SOL_SOCKET;
+    cmsg->cmsg_type = SCM_RIGHTS;
+    cmsg->cmsg_len = CMSG_LEN(sizeof(int) * fds.size());
+    std::memcpy(CMSG_DATA(cmsg), fds.data(), sizeof(int) * fds.size());
+
+    auto sent = directory != -1;
+    if (sent) {
+      std::scoped_lock const lock{sending};
+      auto const socket = control.load();
+      ssize_t count = -1;
+      do {
+        count = sendmsg(socket, &message, MSG_NOSIGNAL);
+      } while (count == -1 && errno == EINTR);
+      sent = count != -1 &&
+             send_all(
+                 socket, reinterpret_cast<char const*>(&header) + count,
+                 sizeof(header) - static_cast<size_t>(count)
+             ) &&
+             send_all(socket, payload.data(), payload.size());
+    }
+    // The helper holds its own copies now
+    close(reply[1]);
+    if (directory != -1) {
+      close(directory);
+    }
+
+    Started started{.pid = -1, .error = 0};
+    if (!sent || !read_all(reply[0], &started, sizeof(started)) ||
+        started.pid == -1) {
+      close(reply[0]);
+      return {};
+    }
+    return {.pid = started.pid, .reply = reply[0]};
+  }
+
+  [[nodiscard]] auto wait(Child const child) -> Exit {
+    Exit exit{};
+    if (!read_all(child.reply, &exit, sizeof(exit))) {
+      // The helper went away, the status is lost
+      exit.status = EX_OSERR << 8;
+    }
+    close(child.reply);
+    return exit;
+  }
+
+  [[nodiscard]] auto apply(std::span<Action const> const actions) -> bool {
+    for (auto const action : actions) {
+      // `dup2` keeps close-on-exec when both descriptors are the same
+      if (action.source == action.target) {
+        fcntl(action.target, F_SETFD, 0);
+        continue;
+      }
+      if (dup2(action.source, action.target) == -1) {
+        return false;
+      }
+    }
+    return true;
+  }
+} // namespace ForkServer
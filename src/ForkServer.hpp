@@ -0,0 +1,51 @@
+#pragma once
+
+#include <span>
+
+#include <sys/resource.h>
+#include <sys/types.h>
+
+// Helper process spawning commands on behalf of the shell. It is forked at
+// startup while the shell is still small, so its `fork` stays cheap no matter
+// how large the shell's heap grows afterwards.
+// Requests carry argv, the environment block, the working directory and the
+// descriptors the child inherits (passed with `SCM_RIGHTS`) over a socket.
+// The helper reaps its children itself and reports their status and resource
+// usage through a pipe created for every spawn.
+namespace ForkServer {
+  // `dup2(source, target)` performed in the child, in order
+  struct Action {
+    int target;
+    int source;
+  };
+
+  // Spawned child, `reply` is only open for children of the fork server
+  struct Child {
+    pid_t pid = -1;
+    int reply = -1;
+  };
+
+  struct Exit {
+    int status = 0;
+    rusage usage{};
+  };
+
+  // Has to run before the shell starts any threads. Returns false when the
+  // helper could not be started, spawns then fork directly
+  auto start() -> bool;
+  // The helper exits once the shell's end of the socket is closed
+  auto stop() -> void;
+  [[nodiscard]] auto running() -> bool;
+
+  // `argv` and `envp` are null terminated. Returns a child without a pid when
+  // the request failed
+  [[nodiscard]] auto spawn(
+      char const* const* argv, char const* const* envp,
+      std::span<Action const> actions
+  ) -> Child;
+  // Blocks until the child exits, closing its reply pipe
+  [[nodiscard]] auto wait(Child child) -> Exit;
+
+  // Applies `actions` in a freshly forked child, shared with direct spawns
+  [[nodiscard]] auto apply(std::span<Action const> actions) -> bool;
+} // namespace ForkServer
@@ -0,0 +1,319 @@
+#include "Glob.hpp"
+
+#include <algorithm>
+#include <array>
+#include <atomic>
+#include <ranges>
+#include <thread>
+
+#include <dirent.h>
+#include <fcntl.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+namespace {
+  using Glob::Cache;
+  using Glob::Entry;
+
+  // Enough for several hundred entries per `getdents64` call
+  constexpr auto DIRECTORY_BUFFER_SIZE = 1 << 16;
+
+  // Reads a whole directory with batched `getdents64` calls. The entry type
+  // comes from `d_type`, so `stat` is only needed for symbolic links and file
+  // systems which do not report it
+  auto read_directory(std::string const& directory) -> std::vector<Entry> {
+    std::vector<Entry> entries{};
+    auto const fd = open(directory.c_str(), O_RDONLY | O_DIRECTORY | O_CLOEXEC);
+    if (fd == -1) {
+      return entries;
+    }
+
+    alignas(dirent64) std::array<char, DIRECTORY_BUFFER_SIZE> buffer{};
+    for (;;) {
+      auto const count = getdents64(fd, buffer.data(), buffer.size());
+      if (count <= 0) {
+        break;
+      }
+      for (ssize_t offset = 0; offset < count;) {
+        auto const* entry =
+            reinterpret_cast<dirent64 const*>(buffer.data() + offset);
+        offset += entry->d_reclen;
+
+        std::string_view const name{entry->d_name};
+        if (name == "." || name == "..") {
+          continue;
+        }
+        auto type = entry->d_type;
+        struct stat status {};
+        if (type == DT_UNKNOWN &&
+            fstatat(fd, entry->d_name, &status, AT_SYMLINK_NOFOLLOW) == 0) {
+          type = IFTODT(status.st_mode);
+        }
+        auto const link = type == DT_LNK;
+        auto const is_directory =
+            type == DT_DIR || (link && fstatat(fd, entry->d_name, &status, 0) ==
+                                           0 &&
+                               S_ISDIR(status.st_mode));
+        entries.push_back(
+            {.name = std::string{name}, .directory = is_directory, .link = link}
+        );
+      }
+    }
+    close(fd);
+
+    return entries;
+  }
+
+  auto directory_of(std::string const& prefix) -> std::string {
+    return prefix.empty() ? "." : prefix;
+  }
+
+  // Length of a bracket expression at the start of `pattern`, 0 when it is
+  // not terminated and therefore taken literally
+  auto match_bracket(
+      std::string_view const pattern, char const let, bool& matched
+  ) -> size_t {
+    size_t pos = 1;
+    auto const negated =
+        pos < pattern.size() && (pattern[pos] == '!' || pattern[pos] == '^');
+    if (negated) {
+      ++pos;
+    }
+
+    matched = false;
+    // A leading `]` is part of the set
+    for (auto const begin = pos;
+         pos < pattern.size() && (pos == begin || pattern[pos] != ']'); ++pos) {
+      if (pos + 2 < pattern.size() && pattern[pos + 1] == '-' &&
+          pattern[pos + 2] != ']') {
+        matched = matched || (pattern[pos] <= let && let <= pattern[pos + 2]);
+        pos += 2;
+      } else {
+        matched = matched || pattern[pos] == let;
+      }
+    }
+    if (pos >= pattern.size()) {
+      return 0;
+    }
+
+    matched = matched != negated;
+    return pos + 1;
+  }
+
+  // Length of the pattern element at the start of `pattern` when it matches
+  // `let`, 0 otherwise
+  auto match_one(std::string_view const pattern, char const let) -> size_t {
+    switch (pattern.front()) {
+    case '?':
+      return 1;
+    case '[': {
+      auto matched = false;
+      if (auto const length = match_bracket(pattern, let, matched);
+          length != 0) {
+        return matched ? length : 0;
+      }
+      break;
+    }
+    case '\\':
+      if (pattern.size() > 1) {
+        return pattern[1] == let ? 2 : 0;
+      }
+      break;
+    default:
+      break;
+    }
+    return pattern.front() == let ? 1 : 0;
+  }
+
+  // Appends everything below `prefix`. Only directories are collected unless
+  // `files` is set. Hidden entries and symbolic links are not descended into
+  auto descend(
+      std::string const& prefix, Cache& cache, std::vector<std::string>& paths,
+      bool const files
+  ) -> void {
+    auto const listing = cache.list(directory_of(prefix));
+    for (auto const& entry : *listing) {
+      if (entry.name.starts_with('.')) {
+        continue;
+      }
+      if (!entry.directory || entry.link) {
+        if (files) {
+          paths.push_back(prefix + entry.name);
+        }
+        continue;
+      }
+      auto path = prefix + entry.name + '/';
+      paths.push_back(files ? prefix + entry.name : path);
+      descend(path, cache, paths, files);
+    }
+  }
+
+  // `descend` with the subdirectories of `prefix` spread over several threads
+  auto descend_parallel(
+      std::string const& prefix, Cache& cache, std::vector<std::string>& paths,
+      bool const files
+  ) -> void {
+    auto const listing = cache.list(directory_of(prefix));
+    std::vector<std::string> subdirectories{};
+    for (auto const& entry : *listing) {
+      if (entry.name.starts_with('.')) {
+        continue;
+      }
+      if (entry.directory && !entry.link) {
+        subdirectories.push_back(prefix + entry.name + '/');
+        paths.push_back(files ? prefix + entry.name : subdirectories.back());
+      } else if (files) {
+        paths.push_back(prefix + entry.name);
+      }
+    }
+
+    auto const workers = std::min<size_t>(
+        std::max(std::thread::hardware_concurrency(), 1U), subdirectories.size()
+    );
+    if (workers <= 1) {
+      for (auto const& subdirectory : subdirectories) {
+        descend(subdirectory, cache, paths, files);
+      }
+      return;
+    }
+
+    // Subdirectories are handed out one at a time since their sizes differ a
+    // lot
+    std::atomic<size_t> next{0};
+    std::vector<std::vector<std::string>> results(workers);
+    {
+      std::vector<std::jthread> threads{};
+      threads.reserve(workers);
+      for (auto& result : results) {
+        threads.emplace_back([&] {
+          for (auto i = next++; i < subdirectories.size(); i = next++) {
+            descend(subdirectories[i], cache, result, files);
+          }
+        });
+      }
+    }
+    for (auto& result : results) {
+      std::ranges::move(result, std::back_inserter(paths));
+    }
+  }
+} // namespace
+
+namespace Glob {
+  [[nodiscard]] auto Cache::list(std::string const& directory) -> Listing {
+    {
+      std::scoped_lock const lock{mutex_};
+      if (auto const found = listings_.find(directory);
+          found != listings_.end()) {
+        return found->second;
+      }
+    }
+
+    // Read without holding the lock so other threads keep going. When two
+    // threads race for the same directory the first listing wins
+    auto listing =
+        std::make_shared<std::vector<Entry> const>(read_directory(directory));
+    std::scoped_lock const lock{mutex_};
+    return listings_.try_emplace(directory, std::move(listing)).first->second;
+  }
+
+  [[nodiscard]] auto has_pattern(std::string_view const word) -> bool {
+    return word.find_first_of("*?[") != std::string_view::npos;
+  }
+
+  [[nodiscard]] auto
+  match(std::string_view const pattern, std::string_view const name) -> bool {
+    // Hidden files have to be matched explicitly
+    if (name.starts_with('.') && !pattern.starts_with('.')) {
+      return false;
+    }
+
+    // Backtracking is only needed to the last `*`
+    auto star = std::string_view::npos;
+    size_t star_name = 0;
+    size_t pos = 0;
+    for (size_t name_pos = 0; name_pos < name.size();) {
+      if (pos < pattern.size() && pattern[pos] == '*') {
+        star = ++pos;
+        star_name = name_pos;
+        continue;
+      }
+      if (pos < pattern.size()) {
+        if (auto const length = match_one(pattern.substr(pos), name[name_pos]);
+            length != 0) {
+          pos += length;
+          ++name_pos;
+          continue;
+        }
+      }
+      if (star == std::string_view::npos) {
+        return false;
+      }
+      pos = star;
+      name_pos = ++star_name;
+    }
+
+    for (; pos < pattern.size() && pattern[pos] == '*'; ++pos) {
+    }
+    return pos == pattern.size();
+  }
+
+  [[nodiscard]] auto expand(std::string_view const pattern, Cache& cache)
+      -> std::vector<std::string> {
+    auto const directories_only = pattern.ends_with('/');
+    std::vector<std::string_view> segments{};
+    for (auto const& segment : std::views::split(pattern, '/')) {
+      if (!segment.empty()) {
+        segments.emplace_back(segment.begin(), segment.end());
+      }
+    }
+
+    std::vector<std::string> paths{pattern.starts_with('/') ? "/" : ""};
+    for (size_t i = 0; i < segments.size() && !paths.empty(); ++i) {
+      auto const segment = segments[i];
+      auto const last = i + 1 == segments.size();
+      std::vector<std::string> next{};
+
+      if (segment == "**") {
+        for (auto const& prefix : paths) {
+          if (!last) {
+            next.push_back(prefix);
+          }
+          descend_parallel(prefix, cache, next, last && !directories_only);
+        }
+      } else if (!has_pattern(segment)) {
+        for (auto const& prefix : paths) {
+          next.push_back(
+              prefix + std::string{segment} +
+              (!last || directories_only ? "/" : "")
+          );
+        }
+      } else {
+        auto const want_directory = !last || directories_only;
+        for (auto const& prefix : paths) {
+          auto const listing = cache.list(directory_of(prefix));
+          for (auto const& entry : *listing) {
+            if ((!want_directory || entry.directory) &&
+                match(segment, entry.name)) {
+              next.push_back(
+                  prefix + entry.name + (want_directory ? "/" : "")
+              );
+            }
+          }
+        }
+      }
+      paths = std::move(next);
+    }
+
+    // Only components containing patterns are verified through listings
+    if (!segments.empty() && !has_pattern(segments.back())) {
+      std::erase_if(paths, [](std::string const& path) {
+        return faccessat(AT_FDCWD, path.c_str(), F_OK, 0) != 0;
+      });
+    }
+    std::ranges::sort(paths);
+    auto const duplicates = std::ranges::unique(paths);
+    paths.erase(duplicates.begin(), duplicates.end());
+
+    return paths;
+  }
+} // namespace Glob
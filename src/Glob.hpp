@@ -0,0 +1,42 @@
+#pragma once
+
+#include <memory>
+#include <mutex>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+#include <vector>
+
+// Pathname expansion of `*`, `?`, `[...]` and `**`
+namespace Glob {
+  struct Entry {
+    std::string name;
+    // Directory or symbolic link to a directory
+    bool directory;
+    bool link;
+  };
+
+  using Listing = std::shared_ptr<std::vector<Entry> const>;
+
+  // Directory listings read while expanding the arguments of a single
+  // command, so every directory is read at most once. Safe to share between
+  // threads
+  class Cache {
+  public:
+    [[nodiscard]] auto list(std::string const& directory) -> Listing;
+
+  private:
+    std::mutex mutex_;
+    std::unordered_map<std::string, Listing> listings_;
+  };
+
+  [[nodiscard]] auto has_pattern(std::string_view word) -> bool;
+
+  // Matches a single path component against a pattern without `/`
+  [[nodiscard]] auto match(std::string_view pattern, std::string_view name)
+      -> bool;
+
+  // Sorted matching paths, empty when nothing matches
+  [[nodiscard]] auto expand(std::string_view pattern, Cache& cache)
+      -> std::vector<std::string>;
+} // namespace Glob
@@ -0,0 +1,95 @@
+#include "History.hpp"
+
+#include <algorithm>
+#include <cstring>
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+History::History(std::string const& path) {
+  constexpr auto MODE = 0600;
+  fd_ = open(path.c_str(), O_RDWR | O_CREAT | O_APPEND | O_CLOEXEC, MODE);
+  if (fd_ == -1) {
+    return;
+  }
+
+  struct stat status {};
+  if (fstat(fd_, &status) == -1 || status.st_size == 0) {
+    return;
+  }
+  auto* const mapping = mmap(
+      nullptr, static_cast<size_t>(status.st_size), PROT_READ, MAP_PRIVATE,
+      fd_, 0
+  );
+  if (mapping == MAP_FAILED) {
+    return;
+  }
+  mapping_ = static_cast<char const*>(mapping);
+  mapping_size_ = static_cast<size_t>(status.st_size);
+
+  // A single `memchr` pass, entries are never parsed again afterwards
+  for (size_t begin = 0; begin < mapping_size_;) {
+    auto const* newline = static_cast<char const*>(
+        std::memchr(mapping_ + begin, '\n', mapping_size_ - begin)
+    );
+    auto const end = newline == nullptr
+                         ? mapping_size_
+                         : static_cast<size_t>(newline - mapping_);
+    if (end != begin) {
+      offsets_.push_back(begin);
+      offsets_.push_back(end);
+    }
+    begin = end + 1;
+  }
+}
+
+History::~History() {
+  if (mapping_ != nullptr) {
+    munmap(const_cast<char*>(mapping_), mapping_size_);
+  }
+  if (fd_ != -1) {
+    close(fd_);
+  }
+}
+
+[[nodiscard]] auto History::size() const -> size_t {
+  return offsets_.size() / 2 + appended_.size();
+}
+
+[[nodiscard]] auto History::at(size_t const index) const -> std::string_view {
+  auto const mapped = offsets_.size() / 2;
+  if (index >= mapped) {
+    return appended_[index - mapped];
+  }
+  auto const begin = offsets_[index * 2];
+  return {mapping_ + begin, offsets_[index * 2 + 1] - begin};
+}
+
+auto History::add(std::string_view const entry) -> void {
+  if (entry.empty() || entry.find('\n') != std::string_view::npos ||
+      (size() != 0 && at(size() - 1) == entry)) {
+    return;
+  }
+  appended_.emplace_back(entry);
+  if (fd_ != -1) {
+    // One `write` per entry, so concurrent shells do not interleave lines
+    auto const line = appended_.back() + '\n';
+    [[maybe_unused]] auto const written = write(fd_, line.data(), line.size());
+  }
+}
+
+[[nodiscard]] auto
+History::search(std::string_view const query, size_t const from) const
+    -> std::optional<size_t> {
+  if (size() == 0) {
+    return std::nullopt;
+  }
+  for (auto index = std::min(from, size() - 1) + 1; index-- > 0;) {
+    if (at(index).find(query) != std::string_view::npos) {
+      return index;
+    }
+  }
+  return std::nullopt;
+}
@@ -0,0 +1,37 @@
+#pragma once
+
+#include <cstddef>
+#include <optional>
+#include <string>
+#include <string_view>
+#include <vector>
+
+// Persistent, newline separated command history. The file is mapped read-only
+// and indexed once on startup, entries added afterwards are appended to the
+// file and kept in memory. Index 0 is the oldest entry
+class History {
+public:
+  explicit History(std::string const& path);
+  History(History const&) = delete;
+  auto operator=(History const&) -> History& = delete;
+  ~History();
+
+  [[nodiscard]] auto size() const -> size_t;
+  [[nodiscard]] auto at(size_t index) const -> std::string_view;
+
+  auto add(std::string_view entry) -> void;
+
+  // Newest entry at or before `from` which contains `query`. Continuing a
+  // search from the previous match when `query` grows is enough, since newer
+  // entries did not even contain the shorter query
+  [[nodiscard]] auto search(std::string_view query, size_t from) const
+      -> std::optional<size_t>;
+
+private:
+  int fd_ = -1;
+  char const* mapping_ = nullptr;
+  size_t mapping_size_ = 0;
+  // Start of every mapped entry followed by the end of the last one
+  std::vector<size_t> offsets_;
+  std::vector<std::string> appended_;
+};
@@ -0,0 +1,261 @@
+#include "Interner.hpp"
+
+#include <functional>
+#include <utility>
+#include <vector>
+
+namespace {
+  auto address(Expr::T const& expr) -> void const* {
+    return std::visit(
+        [](auto const& node) -> void const* { return node.get(); }, expr
+    );
+  }
+
+  template <class Node> auto alternative() -> size_t {
+    return Expr::T{std::shared_ptr<Node>{}}.index();
+  }
+
+  auto combine(size_t const seed, size_t const value) -> size_t {
+    constexpr size_t GOLDEN_RATIO = 0x9e3779b97f4a7c15;
+    return seed ^ (value + GOLDEN_RATIO + (seed << 6) + (seed >> 2));
+  }
+
+  // How often every node is reached from the root and whether its subtree is
+  // free of side effects
+  class UseCounter {
+  public:
+    struct Use {
+      Expr::T node;
+      uint32_t count = 0;
+      bool pure = true;
+    };
+
+    std::unordered_map<void const*, Use> uses;
+
+    // Operators are walked with an explicit stack, they can be nested
+    // arbitrarily deep. Other nodes recurse through `visit_node`
+    auto visit(Expr::T const& expr) -> bool {
+      struct Visit {
+        Expr::T const* node;
+        bool operands_visited;
+      };
+      std::vector<Visit> pending{{&expr, false}};
+      std::vector<bool> pure{};
+
+      while (!pending.empty()) {
+        auto const [node, operands_visited] = pending.back();
+        pending.pop_back();
+        auto const* key = address(*node);
+
+        if (operands_visited) {
+          if (std::holds_alternative<Expr::BinaryPtr>(*node)) {
+            auto const right = pure.back();
+            pure.pop_back();
+            pure.back() = pure.back() && right;
+          }
+          uses.at(key).pure = pure.back();
+          continue;
+        }
+
+        auto [found, inserted] = uses.try_emplace(key, Use{.node = *node});
+        ++found->second.count;
+        if (!inserted) {
+          // Groupings have no slot of their own, every use of a shared one is
+          // a use of the expression inside
+          if (auto const* grouping = std::get_if<Expr::GroupingPtr>(node)) {
+            pending.push_back({&(*grouping)->expression, false});
+            continue;
+          }
+          // Children of a shared node are only counted once, they are
+          // evaluated once when the node itself is memoized
+          pure.push_back(found->second.pure);
+          continue;
+        }
+
+        if (auto const* grouping = std::get_if<Expr::GroupingPtr>(node)) {
+          pending.push_back({node, true});
+          pending.push_back({&(*grouping)->expression, false});
+        } else if (auto const* unary = std::get_if<Expr::UnaryPtr>(node)) {
+          pending.push_back({node, true});
+          pending.push_back({&(*unary)->expression, false});
+        } else if (auto const* binary = std::get_if<Expr::BinaryPtr>(node)) {
+          // The left operand is visited first
+          pending.push_back({node, true});
+          pending.push_back({&(*binary)->right, false});
+          pending.push_back({&(*binary)->left, false});
+        } else {
+          auto const node_pure = visit_node(*node);
+          // `found` might have been invalidated while visiting the children
+          uses.at(key).pure = node_pure;
+          pure.push_back(node_pure);
+        }
+      }
+      return pure.back();
+    }
+
+    auto visit_node(Expr::T const& expr) -> bool {
+      return std::visit(
+          overloads{
+              [](Expr::LiteralPtr const&) { return true; },
+              [](Expr::VariablePtr const&) { return true; },
+              [](Expr::SubstitutionPtr const&) { return false; },
+              [this](Expr::ArrayPtr const& node) {
+                return visit_all(node->elements);
+              },
+              [this](Expr::CallPtr const& node) {
+                return visit_all(node->arguments);
+              },
+              // Loop variables change between iterations, so neither they
+              // nor anything using them may be memoized. Loops themselves
+              // are statements, which are evaluated once anyway
+              [](Expr::LocalPtr const&) { return false; },
+              [this](Expr::ForPtr const& node) {
+                visit(node->iterable);
+                if (node->last) {
+                  visit(node->last.value());
+                }
+                visit_all(node->body);
+                return false;
+              },
+              [this](Expr::BreakPtr const& node) {
+                if (node->condition) {
+                  visit(node->condition.value());
+                }
+                return false;
+              },
+              [this](Expr::PrintPtr const& node) {
+                visit(node->expression);
+                return false;
+              },
+              [](auto const&) -> bool { std::unreachable(); }
+          },
+          expr
+      );
+    }
+
+    auto visit_all(std::vector<Expr::T> const& expressions) -> bool {
+      auto pure = true;
+      for (auto const& expression : expressions) {
+        pure = visit(expression) && pure;
+      }
+      return pure;
+    }
+  };
+} // namespace
+
+auto Interner::Hash::operator()(Key const& key) const -> size_t {
+  auto seed = std::hash<size_t>{}(key.alternative);
+  seed = combine(seed, std::hash<int>{}(std::to_underlying(key.kind)));
+  if (key.literal) {
+    seed = combine(seed, std::hash<Token::Literal>{}(key.literal.value()));
+  }
+  seed = combine(seed, std::hash<void const*>{}(key.left));
+  return combine(seed, std::hash<void const*>{}(key.right));
+}
+
+template <class Make> auto Interner::intern(Key key, Make make) -> Expr::T {
+  auto [found, inserted] = nodes_.try_emplace(std::move(key));
+  if (inserted) {
+    found->second = make();
+  }
+  return found->second;
+}
+
+[[nodiscard]] auto Interner::literal(Token token) -> Expr::T {
+  Key key{
+      .alternative = alternative<Expr::Literal>(),
+      .kind = token.kind_,
+      .literal = token.literal_,
+      .left = nullptr,
+      .right = nullptr
+  };
+  return intern(std::move(key), [&token] {
+    return Expr::Literal::init(std::move(token));
+  });
+}
+
+[[nodiscard]] auto Interner::variable(Token name) -> Expr::T {
+  Key key{
+      .alternative = alternative<Expr::Variable>(),
+      .kind = name.kind_,
+      .literal = name.literal_,
+      .left = nullptr,
+      .right = nullptr
+  };
+  return intern(std::move(key), [&name] {
+    return Expr::Variable::init(std::move(name));
+  });
+}
+
+[[nodiscard]] auto Interner::grouping(Expr::T expression) -> Expr::T {
+  Key key{
+      .alternative = alternative<Expr::Grouping>(),
+      .kind = Token::Kind::LEFT_PAREN,
+      .literal = std::nullopt,
+      .left = address(expression),
+      .right = nullptr
+  };
+  return intern(std::move(key), [&expression] {
+    return Expr::Grouping::init(std::move(expression));
+  });
+}
+
+[[nodiscard]] auto Interner::unary(Token operation, Expr::T expression)
+    -> Expr::T {
+  Key key{
+      .alternative = alternative<Expr::Unary>(),
+      .kind = operation.kind_,
+      .literal = std::nullopt,
+      .left = address(expression),
+      .right = nullptr
+  };
+  return intern(std::move(key), [&operation, &expression] {
+    return Expr::Unary::init(std::move(operation), std::move(expression));
+  });
+}
+
+[[nodiscard]] auto
+Interner::binary(Expr::T left, Token operation, Expr::T right) -> Expr::T {
+  Key key{
+      .alternative = alternative<Expr::Binary>(),
+      .kind = operation.kind_,
+      .literal = std::nullopt,
+      .left = address(left),
+      .right = address(right)
+  };
+  return intern(std::move(key), [&left, &operation, &right] {
+    return Expr::Binary::init(
+        std::move(left), std::move(operation), std::move(right)
+    );
+  });
+}
+
+auto Interner::assign_slots(std::span<Expr::T const> const statements)
+    -> uint32_t {
+  UseCounter counter{};
+  for (auto const& statement : statements) {
+    counter.visit(statement);
+  }
+
+  uint32_t slots = 0;
+  for (auto const& [key, use] : counter.uses) {
+    auto const shared = use.count > 1 && use.pure;
+    std::visit(
+        overloads{
+            [&slots, shared](Expr::UnaryPtr const& node) {
+              node->slot = shared ? std::optional{slots++} : std::nullopt;
+            },
+            [&slots, shared](Expr::BinaryPtr const& node) {
+              node->slot = shared ? std::optional{slots++} : std::nullopt;
+            },
+            [](auto const&) {}
+        },
+        use.node
+    );
+  }
+  return slots;
+}
+
+[[nodiscard]] auto Interner::is_pure(Expr::T const& expression) -> bool {
+  return UseCounter{}.visit(expression);
+}
@@ -0,0 +1,50 @@
+#pragma once
+#include "Expr.hpp"
+
+#include <cstdint>
+#include <optional>
+#include <span>
+#include <unordered_map>
+
+// Hash-consing of expression nodes. Structurally equal pure subtrees are built
+// once and shared, e.g. both sides of `(a * b) + (a * b)` are the same node.
+// Children are interned before their parents, so comparing children by
+// address is enough to compare whole subtrees.
+// Command substitutions and loop variables are never shared since their
+// values change, which also keeps every expression containing one unique.
+class Interner {
+public:
+  [[nodiscard]] auto literal(Token token) -> Expr::T;
+  [[nodiscard]] auto variable(Token name) -> Expr::T;
+  [[nodiscard]] auto grouping(Expr::T expression) -> Expr::T;
+  [[nodiscard]] auto unary(Token operation, Expr::T expression) -> Expr::T;
+  [[nodiscard]] auto binary(Expr::T left, Token operation, Expr::T right)
+      -> Expr::T;
+
+  // Gives every pure unary and binary node reached more than once a
+  // memoization slot, so it is evaluated once per evaluation. Returns the
+  // number of slots used
+  static auto assign_slots(std::span<Expr::T const> statements) -> uint32_t;
+  // Whether evaluating `expression` always gives the same value without
+  // side effects, i.e. it runs no commands and prints nothing
+  [[nodiscard]] static auto is_pure(Expr::T const& expression) -> bool;
+
+private:
+  struct Key {
+    size_t alternative;
+    Token::Kind kind;
+    std::optional<Token::Literal> literal;
+    void const* left;
+    void const* right;
+
+    auto operator==(Key const&) const -> bool = default;
+  };
+
+  struct Hash {
+    auto operator()(Key const& key) const -> size_t;
+  };
+
+  template <class Make> auto intern(Key key, Make make) -> Expr::T;
+
+  std::unordered_map<Key, Expr::T, Hash> nodes_;
+};
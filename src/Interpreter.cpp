@@ -1,61 +1,232 @@
 #include "Interpreter.hpp"
+#include "Command.hpp"
 #include "Log.hpp"
+#include <cmath>
 #include <stdexcept>
 #include <utility>
 
-[[nodiscard]] auto Interpreter::eval(std::optional<Expr::T> line
-) -> std::optional<Literal> {
+[[nodiscard]] auto
+Interpreter::eval(std::optional<Expr::T> line, uint32_t const slots)
+    -> std::optional<Literal> {
   if (line) {
     expression_ = line.value();
   }
+  memo_.assign(slots, std::nullopt);
+  frames_.clear();
+  values_.clear();
   try {
     return visit_expression(expression_);
   } catch (std::exception const& err) {
-    Log::warn(err.what());
+    report(err);
   }
   return std::nullopt;
 }
 
+[[nodiscard]] auto Interpreter::eval(
+    std::span<Expr::T const> const statements, uint32_t const slots
+) -> std::optional<Literal> {
+  // Shared subexpressions may span statements, so the memo is kept for the
+  // whole program
+  memo_.assign(slots, std::nullopt);
+  frames_.clear();
+  values_.clear();
+  std::optional<Literal> result{};
+  try {
+    for (auto const& statement : statements) {
+      result = visit_expression(statement);
+    }
+  } catch (std::exception const& err) {
+    report(err);
+    return std::nullopt;
+  }
+  return result;
+}
+
+auto Interpreter::report(std::exception const& error) const -> void {
+  if (sink_) {
+    sink_(error.what());
+  } else {
+    Log::warn("{}", error.what());
+  }
+}
+
+[[nodiscard]] auto Interpreter::display(Literal const& literal) -> std::string {
+  return std::visit(
+      overloads{
+          [](std::string const& value) { return value; },
+          [](double const value) { return fmt::format("{}", value); },
+          [](bool const value) -> std::string {
+            return value ? "true" : "false";
+          },
+          [](Array const& value) { return value.display(); }
+      },
+      literal
+  );
+}
+
+template <class Node, class Visit>
+[[nodiscard]] auto Interpreter::memoized(Node const& node, Visit visit) const
+    -> Literal const& {
+  auto& result = memo_[node->slot.value()];
+  if (!result) {
+    result = visit(node);
+  }
+  return result.value();
+}
+
+// Operators are evaluated without recursion, nested arbitrarily deep they
+// would overflow the native stack. Only other nodes recurse, which `Parser`
+// bounds, and specialized operations, which `Typing::infer` bounds
 [[nodiscard]] auto Interpreter::visit_expression(Expr::T const& expr
 ) const -> Literal {
-  if (std::holds_alternative<Expr::BinaryPtr>(expr)) {
-    return visit_binary(std::get<Expr::BinaryPtr>(expr));
+  auto const base = frames_.size();
+  evaluate(expr);
+  while (frames_.size() > base) {
+    auto const [node, step] = frames_.back();
+    frames_.pop_back();
+
+    if (step == Step::EVALUATE) {
+      evaluate(*node);
+    } else if (auto const* unary = std::get_if<Expr::UnaryPtr>(node)) {
+      values_.back() = apply_unary((*unary)->operation, values_.back());
+      remember((*unary)->slot);
+    } else {
+      auto const& binary = std::get<Expr::BinaryPtr>(*node);
+      auto const& operation = binary->operation;
+      switch (step) {
+      case Step::RIGHT:
+        // The right operand of `&&` and `||` is only evaluated when the left
+        // one does not decide the result, e.g. the command of
+        // `false && $(command) == ""` never runs
+        if (operation.kind_ == Token::Kind::AND ||
+            operation.kind_ == Token::Kind::OR) {
+          if (logical_operand(operation, values_.back()) ==
+              (operation.kind_ == Token::Kind::OR)) {
+            remember(binary->slot);
+            continue;
+          }
+          values_.pop_back();
+          frames_.push_back({node, Step::LOGICAL});
+        } else {
+          frames_.push_back({node, Step::APPLY});
+        }
+        evaluate(binary->right);
+        break;
+      case Step::APPLY: {
+        auto const right = std::move(values_.back());
+        values_.pop_back();
+        values_.back() = apply_binary(operation, values_.back(), right);
+        remember(binary->slot);
+        break;
+      }
+      case Step::LOGICAL:
+        static_cast<void>(logical_operand(operation, values_.back()));
+        remember(binary->slot);
+        break;
+      default:
+        std::unreachable();
+      }
+    }
   }
-  if (std::holds_alternative<Expr::UnaryPtr>(expr)) {
-    return visit_unary(std::get<Expr::UnaryPtr>(expr));
+
+  auto result = std::move(values_.back());
+  values_.pop_back();
+  return result;
+}
+
+auto Interpreter::evaluate(Expr::T const& expr) const -> void {
+  if (auto const* binary = std::get_if<Expr::BinaryPtr>(&expr)) {
+    auto const& node = *binary;
+    if (node->slot && memo_[node->slot.value()]) {
+      values_.push_back(memo_[node->slot.value()].value());
+    } else if (node->specialization != Expr::Specialization::GENERIC) {
+      values_.push_back(visit_specialized(node));
+      remember(node->slot);
+    } else {
+      frames_.push_back({&expr, Step::RIGHT});
+      frames_.push_back({&node->left, Step::EVALUATE});
+    }
+    return;
   }
-  if (std::holds_alternative<Expr::GroupingPtr>(expr)) {
-    return visit_grouping(std::get<Expr::GroupingPtr>(expr));
+  if (auto const* unary = std::get_if<Expr::UnaryPtr>(&expr)) {
+    auto const& node = *unary;
+    if (node->slot && memo_[node->slot.value()]) {
+      values_.push_back(memo_[node->slot.value()].value());
+    } else {
+      frames_.push_back({&expr, Step::APPLY});
+      frames_.push_back({&node->expression, Step::EVALUATE});
+    }
+    return;
   }
-  if (std::holds_alternative<Expr::LiteralPtr>(expr)) {
-    return visit_literal(std::get<Expr::LiteralPtr>(expr));
+  if (auto const* grouping = std::get_if<Expr::GroupingPtr>(&expr)) {
+    frames_.push_back({&(*grouping)->expression, Step::EVALUATE});
+    return;
   }
+  values_.push_back(visit_node(expr));
+}
 
-  throw std::logic_error("unsupported expression type");
+auto Interpreter::remember(std::optional<uint32_t> const slot) const -> void {
+  if (slot) {
+    memo_[slot.value()] = values_.back();
+  }
 }
 
 // NOTE: Visiting methods are not static because let bindings and operations
 // with side effects would require managing class state
-[[nodiscard]] auto Interpreter::visit_binary(Expr::BinaryPtr const& expr
+[[nodiscard]] auto Interpreter::visit_node(Expr::T const& expr
 ) const -> Literal {
-  auto const left = visit_expression(expr->left);
-  auto const right = visit_expression(expr->right);
+  if (std::holds_alternative<Expr::LiteralPtr>(expr)) {
+    return visit_literal(std::get<Expr::LiteralPtr>(expr));
+  }
+  if (std::holds_alternative<Expr::SubstitutionPtr>(expr)) {
+    return visit_substitution(std::get<Expr::SubstitutionPtr>(expr));
+  }
+  if (std::holds_alternative<Expr::VariablePtr>(expr)) {
+    return visit_variable(std::get<Expr::VariablePtr>(expr));
+  }
+  if (std::holds_alternative<Expr::ArrayPtr>(expr)) {
+    return visit_array(std::get<Expr::ArrayPtr>(expr));
+  }
+  if (std::holds_alternative<Expr::CallPtr>(expr)) {
+    return visit_call(std::get<Expr::CallPtr>(expr));
+  }
+  if (std::holds_alternative<Expr::LocalPtr>(expr)) {
+    return visit_local(std::get<Expr::LocalPtr>(expr));
+  }
+  if (std::holds_alternative<Expr::ForPtr>(expr)) {
+    return visit_for(std::get<Expr::ForPtr>(expr));
+  }
+  if (std::holds_alternative<Expr::PrintPtr>(expr)) {
+    return visit_print(std::get<Expr::PrintPtr>(expr));
+  }
+
+  throw std::logic_error("unsupported expression type");
+}
+
+[[nodiscard]] auto Interpreter::apply_binary(
+    Token const& operation, Literal const& left, Literal const& right
+) -> Literal {
+  if (std::holds_alternative<Array>(left) ||
+      std::holds_alternative<Array>(right)) {
+    return visit_elementwise(operation, left, right);
+  }
   if (left.index() != right.index()) {
     throw std::logic_error("different expression types used in binary operation"
     );
   }
-  switch (expr->operation.kind_) {
+  switch (operation.kind_) {
     using Kind = Token::Kind;
   case (Kind::MINUS):
   case (Kind::SLASH):
   case (Kind::STAR):
+  case (Kind::PERCENT):
   case (Kind::GREATER):
   case (Kind::GREATER_EQUAL):
   case (Kind::LESS):
   case (Kind::LESS_EQUAL):
     if (!std::holds_alternative<double>(left)) {
       throw std::logic_error(fmt::format(
-          "'{}' operation only avaliable for numbers", expr->operation.display()
+          "'{}' operation only avaliable for numbers", operation.display()
       ));
     }
     break;
@@ -67,14 +238,14 @@
         !std::holds_alternative<std::string>(left)) {
       throw std::logic_error(fmt::format(
           "'{}' operation only avaliable for numbers or strings",
-          expr->operation.display()
+          operation.display()
       ));
     }
     break;
   default:
     std::unreachable();
   }
-  switch (expr->operation.kind_) {
+  switch (operation.kind_) {
     using Kind = Token::Kind;
   case (Kind::MINUS):
     return std::get<double>(left) - std::get<double>(right);
@@ -82,6 +253,8 @@
     return std::get<double>(left) / std::get<double>(right);
   case (Kind::STAR):
     return std::get<double>(left) * std::get<double>(right);
+  case (Kind::PERCENT):
+    return std::fmod(std::get<double>(left), std::get<double>(right));
   case (Kind::GREATER):
     return std::get<double>(left) > std::get<double>(right);
   case (Kind::GREATER_EQUAL):
@@ -110,31 +283,164 @@
   }
 }
 
+[[nodiscard]] auto Interpreter::logical_operand(
+    Token const& operation, Literal const& operand
+) -> bool {
+  auto const* value = std::get_if<bool>(&operand);
+  if (value == nullptr) {
+    throw std::logic_error(fmt::format(
+        "'{}' operation only avaliable for booleans", operation.display()
+    ));
+  }
+  return *value;
+}
+
+[[nodiscard]] auto Interpreter::visit_specialized(Expr::BinaryPtr const& expr
+) const -> Literal {
+  switch (expr->specialization) {
+    using Specialization = Expr::Specialization;
+  case Specialization::STRING_CONCATENATE:
+    return visit_string(expr->left) + visit_string(expr->right);
+  case Specialization::STRING_EQUAL:
+    return visit_string(expr->left) == visit_string(expr->right);
+  case Specialization::STRING_NOT_EQUAL:
+    return visit_string(expr->left) != visit_string(expr->right);
+  case Specialization::NUMBER_GREATER:
+    return visit_number(expr->left) > visit_number(expr->right);
+  case Specialization::NUMBER_GREATER_EQUAL:
+    return visit_number(expr->left) >= visit_number(expr->right);
+  case Specialization::NUMBER_LESS:
+    return visit_number(expr->left) < visit_number(expr->right);
+  case Specialization::NUMBER_LESS_EQUAL:
+    return visit_number(expr->left) <= visit_number(expr->right);
+  case Specialization::NUMBER_EQUAL:
+    return visit_number(expr->left) == visit_number(expr->right);
+  case Specialization::NUMBER_NOT_EQUAL:
+    return visit_number(expr->left) != visit_number(expr->right);
+  default:
+    return visit_number(expr);
+  }
+}
+
+// NOTE: Only reached through annotated nodes, which guarantees every operand
+// below is a number
+[[nodiscard]] auto Interpreter::visit_number(Expr::T const& expr
+) const -> double {
+  return std::visit(
+      overloads{
+          [](Expr::LiteralPtr const& node) {
+            return *std::get_if<double>(&*node->token.literal_);
+          },
+          [this](Expr::GroupingPtr const& node) {
+            return visit_number(node->expression);
+          },
+          [this](Expr::UnaryPtr const& node) {
+            if (node->slot) {
+              return std::get<double>(
+                  memoized(node, [this](auto const& shared) {
+                    return visit_unary(shared);
+                  })
+              );
+            }
+            return -visit_number(node->expression);
+          },
+          [this](Expr::CallPtr const& node) { return visit_call(node); },
+          [this](Expr::BinaryPtr const& node) {
+            // Computed from the operands, going through the node again
+            // would find its memo slot still empty
+            auto const arithmetic = [this](Expr::BinaryPtr const& shared) {
+              auto const left = visit_number(shared->left);
+              auto const right = visit_number(shared->right);
+              switch (shared->specialization) {
+                using Specialization = Expr::Specialization;
+              case Specialization::NUMBER_ADD:
+                return left + right;
+              case Specialization::NUMBER_SUBTRACT:
+                return left - right;
+              case Specialization::NUMBER_MULTIPLY:
+                return left * right;
+              case Specialization::NUMBER_DIVIDE:
+                return left / right;
+              case Specialization::NUMBER_MODULO:
+                return std::fmod(left, right);
+              default:
+                std::unreachable();
+              }
+            };
+            if (node->slot) {
+              return std::get<double>(memoized(node, [&](auto const& shared) {
+                return Literal{arithmetic(shared)};
+              }));
+            }
+            return arithmetic(node);
+          },
+          [](auto const&) -> double { std::unreachable(); }
+      },
+      expr
+  );
+}
+
+// NOTE: Same guarantee as `visit_number`, for strings
+[[nodiscard]] auto Interpreter::visit_string(Expr::T const& expr
+) const -> std::string {
+  return std::visit(
+      overloads{
+          [](Expr::LiteralPtr const& node) {
+            return *std::get_if<std::string>(&*node->token.literal_);
+          },
+          [this](Expr::GroupingPtr const& node) {
+            return visit_string(node->expression);
+          },
+          [this](Expr::BinaryPtr const& node) {
+            if (node->slot) {
+              return std::get<std::string>(memoized(
+                  node,
+                  [this](auto const& shared) {
+                    return visit_specialized(shared);
+                  }
+              ));
+            }
+            return visit_string(node->left) + visit_string(node->right);
+          },
+          [this](Expr::SubstitutionPtr const& node) {
+            return std::get<std::string>(visit_substitution(node));
+          },
+          [this](Expr::VariablePtr const& node) {
+            return std::get<std::string>(visit_variable(node));
+          },
+          [](auto const&) -> std::string { std::unreachable(); }
+      },
+      expr
+  );
+}
+
 [[nodiscard]] auto Interpreter::visit_unary(Expr::UnaryPtr const& expr
 ) const -> Literal {
-  if (expr->operation.kind_ == Token::Kind::MINUS) {
-    auto const literal = visit_expression(expr->expression);
-    if (!std::holds_alternative<double>(literal)) {
+  return apply_unary(expr->operation, visit_expression(expr->expression));
+}
+
+[[nodiscard]] auto Interpreter::apply_unary(
+    Token const& operation, Literal const& operand
+) -> Literal {
+  if (operation.kind_ == Token::Kind::MINUS) {
+    if (auto const* array = std::get_if<Array>(&operand)) {
+      return Array::apply(Simd::Operation::SUBTRACT, 0.0, *array);
+    }
+    if (!std::holds_alternative<double>(operand)) {
       throw std::logic_error("sign negation only operates on numbers");
     }
-    return -std::get<double>(literal);
+    return -std::get<double>(operand);
   }
   // Replace with `not` keyword?
-  if (expr->operation.kind_ == Token::Kind::BANG) {
-    auto const literal = visit_expression(expr->expression);
-    if (!std::holds_alternative<bool>(literal)) {
+  if (operation.kind_ == Token::Kind::BANG) {
+    if (!std::holds_alternative<bool>(operand)) {
       throw std::logic_error("not operator only operates on booleans");
     }
-    return !std::get<bool>(literal);
+    return !std::get<bool>(operand);
   }
   throw std::logic_error("invalid unary operation");
 }
 
-[[nodiscard]] auto Interpreter::visit_grouping(Expr::GroupingPtr const& expr
-) const -> Literal {
-  return visit_expression(expr->expression);
-}
-
 [[nodiscard]] auto Interpreter::visit_literal(Expr::LiteralPtr const& expr
 ) const -> Literal {
   switch (expr->token.kind_) {
@@ -160,3 +466,235 @@
     );
   }
 }
+
+[[nodiscard]] auto
+Interpreter::visit_substitution(Expr::SubstitutionPtr const& expr
+) const -> Literal {
+  if (!expr->command.literal_) {
+    throw std::logic_error("empty command substitution");
+  }
+  auto output = Command::capture(
+      std::get<std::string>(expr->command.literal_.value())
+  );
+  if (!output) {
+    throw std::logic_error("command substitution failed");
+  }
+  auto const length = output->trimmed().size();
+  auto data = std::move(output.value()).release();
+  data.resize(length);
+  return data;
+}
+
+[[nodiscard]] auto Interpreter::visit_variable(Expr::VariablePtr const& expr
+) const -> Literal {
+  auto value = Environment::global().get(expr->reference);
+  if (!value) {
+    throw std::logic_error(
+        fmt::format("unset variable: ${}", expr->reference->name())
+    );
+  }
+  return std::move(value.value());
+}
+
+[[nodiscard]] auto Interpreter::visit_array(Expr::ArrayPtr const& expr
+) const -> Literal {
+  std::vector<double> values{};
+  values.reserve(expr->elements.size());
+  for (auto const& element : expr->elements) {
+    auto const value = visit_expression(element);
+    if (!std::holds_alternative<double>(value)) {
+      throw std::logic_error("array elements have to be numbers");
+    }
+    values.push_back(std::get<double>(value));
+  }
+  return Array::from(values);
+}
+
+[[nodiscard]] auto Interpreter::visit_call(Expr::CallPtr const& expr
+) const -> double {
+  auto const argument = visit_expression(expr->arguments.front());
+  auto const* array = std::get_if<Array>(&argument);
+  if (array == nullptr) {
+    throw std::logic_error(fmt::format(
+        "{} only operates on arrays",
+        std::get<std::string>(expr->callee.literal_.value())
+    ));
+  }
+  switch (expr->builtin) {
+    using Builtin = Expr::Call::Builtin;
+  case Builtin::SUM:
+    return array->sum();
+  case Builtin::MIN:
+    return array->min();
+  case Builtin::MAX:
+    return array->max();
+  case Builtin::LEN:
+    return static_cast<double>(array->size());
+  default:
+    std::unreachable();
+  }
+}
+
+[[nodiscard]] auto Interpreter::visit_local(Expr::LocalPtr const& expr
+) const -> Literal {
+  return locals_[expr->depth];
+}
+
+// Every iterable is consumed lazily: ranges count, arrays are indexed and
+// command output is read line by line while the command runs
+[[nodiscard]] auto Interpreter::visit_for(Expr::ForPtr const& expr
+) const -> Literal {
+  if (locals_.size() <= expr->depth) {
+    locals_.resize(expr->depth + 1);
+  }
+  size_t iterations = 0;
+  auto const iterate = [this, &expr, &iterations](Literal value) {
+    locals_[expr->depth] = std::move(value);
+    ++iterations;
+    return run_body(expr->body);
+  };
+
+  if (expr->last) {
+    auto const first = visit_expression(expr->iterable);
+    auto const last = visit_expression(expr->last.value());
+    // Counted in integers, incrementing a double stops changing it past 2^53
+    auto const bound = [](Literal const& value) {
+      constexpr auto LIMIT = 9007199254740992.0;
+      auto const* number = std::get_if<double>(&value);
+      if (number == nullptr || *number != std::trunc(*number) ||
+          std::abs(*number) > LIMIT) {
+        throw std::logic_error(
+            "range bounds have to be integers between -2^53 and 2^53"
+        );
+      }
+      return static_cast<int64_t>(*number);
+    };
+    auto const last_value = bound(last);
+    for (auto value = bound(first);
+         value <= last_value && iterate(static_cast<double>(value)); ++value) {
+    }
+    return static_cast<double>(iterations);
+  }
+
+  if (auto const* substitution =
+          std::get_if<Expr::SubstitutionPtr>(&expr->iterable)) {
+    auto const& command = (*substitution)->command;
+    if (!command.literal_) {
+      throw std::logic_error("empty command substitution");
+    }
+    // Stops the command when leaving early, by `break` or by an error
+    auto stream =
+        Command::stream(std::get<std::string>(command.literal_.value()));
+    if (!stream) {
+      throw std::logic_error("command substitution failed");
+    }
+    while (auto const line = stream->next_line()) {
+      if (!iterate(std::string{line.value()})) {
+        break;
+      }
+    }
+    return static_cast<double>(iterations);
+  }
+
+  auto const iterable = visit_expression(expr->iterable);
+  if (auto const* array = std::get_if<Array>(&iterable)) {
+    for (size_t i = 0; i < array->size() && iterate(array->at(i)); ++i) {
+    }
+  } else if (auto const* string = std::get_if<std::string>(&iterable)) {
+    // Split like streamed output, a trailing newline ends the last line
+    // instead of starting an empty one
+    for (std::string_view rest = *string; !rest.empty();) {
+      auto const newline = rest.find('\n');
+      auto const line = rest.substr(0, newline);
+      rest = newline == std::string_view::npos ? std::string_view{}
+                                               : rest.substr(newline + 1);
+      if (!iterate(std::string{line})) {
+        break;
+      }
+    }
+  } else {
+    throw std::logic_error(
+        "only ranges, arrays, strings and command output can be iterated"
+    );
+  }
+  return static_cast<double>(iterations);
+}
+
+[[nodiscard]] auto Interpreter::run_body(std::vector<Expr::T> const& body
+) const -> bool {
+  for (auto const& statement : body) {
+    auto const* leave = std::get_if<Expr::BreakPtr>(&statement);
+    if (leave == nullptr) {
+      // Only evaluated for its effects
+      static_cast<void>(visit_expression(statement));
+      continue;
+    }
+    if (!(*leave)->condition) {
+      return false;
+    }
+    auto const condition = visit_expression((*leave)->condition.value());
+    if (!std::holds_alternative<bool>(condition)) {
+      throw std::logic_error("break condition has to be a boolean");
+    }
+    if (std::get<bool>(condition)) {
+      return false;
+    }
+  }
+  return true;
+}
+
+[[nodiscard]] auto Interpreter::visit_print(Expr::PrintPtr const& expr
+) const -> Literal {
+  auto value = visit_expression(expr->expression);
+  fmt::print("{}\n", display(value));
+  return value;
+}
+
+// At least one side is an array, numbers are broadcast
+[[nodiscard]] auto Interpreter::visit_elementwise(
+    Token const& operation, Literal const& left, Literal const& right
+) -> Literal {
+  auto const kernel = [&operation] {
+    switch (operation.kind_) {
+      using Kind = Token::Kind;
+      using Operation = Simd::Operation;
+    case Kind::PLUS:
+      return Operation::ADD;
+    case Kind::MINUS:
+      return Operation::SUBTRACT;
+    case Kind::STAR:
+      return Operation::MULTIPLY;
+    case Kind::SLASH:
+      return Operation::DIVIDE;
+    case Kind::LESS:
+      return Operation::LESS;
+    case Kind::LESS_EQUAL:
+      return Operation::LESS_EQUAL;
+    case Kind::GREATER:
+      return Operation::GREATER;
+    case Kind::GREATER_EQUAL:
+      return Operation::GREATER_EQUAL;
+    case Kind::EQUAL_EQUAL:
+      return Operation::EQUAL;
+    case Kind::BANG_EQUAL:
+      return Operation::NOT_EQUAL;
+    default:
+      throw std::logic_error(fmt::format(
+          "'{}' operation not avaliable for arrays", operation.display()
+      ));
+    }
+  }();
+
+  auto const* left_array = std::get_if<Array>(&left);
+  auto const* right_array = std::get_if<Array>(&right);
+  if (left_array != nullptr && right_array != nullptr) {
+    return Array::apply(kernel, *left_array, *right_array);
+  }
+  if (left_array != nullptr && std::holds_alternative<double>(right)) {
+    return Array::apply(kernel, *left_array, std::get<double>(right));
+  }
+  if (right_array != nullptr && std::holds_alternative<double>(left)) {
+    return Array::apply(kernel, std::get<double>(left), *right_array);
+  }
+  throw std::logic_error("arrays only operate with arrays and numbers");
+}
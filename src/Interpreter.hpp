@@ -1,23 +1,110 @@
 #pragma once
+#include "Array.hpp"
 #include "Expr.hpp"
+#include <cstdint>
+#include <exception>
+#include <functional>
 #include <optional>
+#include <span>
+#include <string_view>
 #include <utility>
+#include <vector>
 
+// NOTE: The interpreter never mutates the expression tree, so a tree can be
+// evaluated by several interpreters (one per thread) at the same time
 class Interpreter {
 public:
-  using Literal = std::variant<std::string, double, bool>;
-  inline explicit Interpreter(Expr::T expression)
-      : expression_(std::move(expression)) {}
+  using Literal = std::variant<std::string, double, bool, Array>;
+  // Receives evaluation errors. `Log::warn` is used when no sink is given
+  using Sink = std::function<void(std::string_view)>;
+
+  inline explicit Interpreter(Sink sink = {}) : sink_(std::move(sink)) {}
+  inline explicit Interpreter(Expr::T expression, Sink sink = {})
+      : expression_(std::move(expression)), sink_(std::move(sink)) {}
+  // `slots` is the number of memoized subexpressions in the expression, see
+  // `Interner::assign_slots`
   [[nodiscard]] auto eval(
-      std::optional<Expr::T> line = std::nullopt
+      std::optional<Expr::T> line = std::nullopt, uint32_t slots = 0
   ) -> std::optional<Literal>;
+  // Evaluates `statements` in order, stopping at the first error. Returns the
+  // value of the last one
+  [[nodiscard]] auto eval(std::span<Expr::T const> statements, uint32_t slots)
+      -> std::optional<Literal>;
+
+  [[nodiscard]] static auto display(Literal const& literal) -> std::string;
 
 private:
   Expr::T expression_;
+  Sink sink_;
+  // Results of shared subexpressions, only valid during a single evaluation
+  mutable std::vector<std::optional<Literal>> memo_;
+  // Current values of loop variables, indexed by `Expr::Local::depth`
+  mutable std::vector<Literal> locals_;
+
+  // Operators are evaluated with an explicit stack, see `visit_expression`
+  enum class Step : uint8_t {
+    // Push the value of the node, or the steps computing it
+    EVALUATE,
+    // The left operand of a binary operation is on `values_`
+    RIGHT,
+    // Every operand is on `values_`
+    APPLY,
+    // Both operands of `&&` or `||` are on `values_`
+    LOGICAL,
+  };
+  struct Frame {
+    Expr::T const* node;
+    Step step;
+  };
+  // Shared by nested calls of `visit_expression`, each one only touches the
+  // entries it pushed
+  mutable std::vector<Frame> frames_;
+  mutable std::vector<Literal> values_;
+
+  auto report(std::exception const& error) const -> void;
+
+  template <class Node, class Visit>
+  [[nodiscard]] auto memoized(Node const& node, Visit visit) const
+      -> Literal const&;
 
   [[nodiscard]] auto visit_expression(Expr::T const& expr) const -> Literal;
-  [[nodiscard]] auto visit_binary(Expr::BinaryPtr const& expr) const -> Literal;
+  // Pushes the value of `expr` on `values_`, or the frames computing it
+  auto evaluate(Expr::T const& expr) const -> void;
+  // Stores the value on top of `values_` in the memoization slot, if any
+  auto remember(std::optional<uint32_t> slot) const -> void;
+  // Nodes other than operators
+  [[nodiscard]] auto visit_node(Expr::T const& expr) const -> Literal;
+  // Operations annotated by `Typing::infer`, their operands are evaluated
+  // through the typed visitors without any runtime type checks
+  [[nodiscard]] auto visit_specialized(Expr::BinaryPtr const& expr
+  ) const -> Literal;
+  [[nodiscard]] auto visit_number(Expr::T const& expr) const -> double;
+  [[nodiscard]] auto visit_string(Expr::T const& expr) const -> std::string;
   [[nodiscard]] auto visit_unary(Expr::UnaryPtr const& expr) const -> Literal;
-  [[nodiscard]] auto visit_grouping(Expr::GroupingPtr const& expr) const -> Literal;
   [[nodiscard]] auto visit_literal(Expr::LiteralPtr const& expr) const -> Literal;
+  [[nodiscard]] auto visit_substitution(Expr::SubstitutionPtr const& expr
+  ) const -> Literal;
+  [[nodiscard]] auto visit_variable(Expr::VariablePtr const& expr
+  ) const -> Literal;
+  [[nodiscard]] auto visit_array(Expr::ArrayPtr const& expr) const -> Literal;
+  [[nodiscard]] auto visit_call(Expr::CallPtr const& expr) const -> double;
+  [[nodiscard]] auto visit_local(Expr::LocalPtr const& expr) const -> Literal;
+  [[nodiscard]] auto visit_for(Expr::ForPtr const& expr) const -> Literal;
+  [[nodiscard]] auto visit_print(Expr::PrintPtr const& expr) const -> Literal;
+  // Evaluates the statements of a loop body, returns false when a `break`
+  // was taken
+  [[nodiscard]] auto run_body(std::vector<Expr::T> const& body) const -> bool;
+  // Operations without specialization, checking the types of their operands
+  [[nodiscard]] static auto apply_unary(
+      Token const& operation, Literal const& operand
+  ) -> Literal;
+  [[nodiscard]] static auto apply_binary(
+      Token const& operation, Literal const& left, Literal const& right
+  ) -> Literal;
+  // Operands of `&&` and `||` have to be booleans
+  [[nodiscard]] static auto
+  logical_operand(Token const& operation, Literal const& operand) -> bool;
+  [[nodiscard]] static auto visit_elementwise(
+      Token const& operation, Literal const& left, Literal const& right
+  ) -> Literal;
 };
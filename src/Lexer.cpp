@@ -1,47 +1,166 @@
 #include "Lexer.hpp"
+#include <algorithm>
 #include <cctype>
 #include <locale>
+#include <stdexcept>
 #include <string>
-#include <unordered_map>
+
+#include <fmt/core.h>
 
 // Unnamed / anonymous namespaces are preferred over globally declared variables
 // which are specified as static
 namespace {
-  using Kind = Token::Kind;
-  std::unordered_map<std::string_view, Token::Kind> keywords{
-      {"(", Kind::LEFT_PAREN},
-      {")", Kind::RIGHT_PAREN},
-      {"[", Kind::LEFT_BRACE},
-      {"]", Kind::RIGHT_BRACE},
-      {",", Kind::COMMA},
-      {":", Kind::COLLON},
-      {".", Kind::DOT},
-      {"-", Kind::MINUS},
-      {"+", Kind::PLUS},
-      {";", Kind::SEMICOLON},
-      {"/", Kind::SLASH},
-      {"*", Kind::STAR},
-      {"&&", Kind::AND},
-      {"begin", Kind::BEGIN},
-      {"end", Kind::END},
-      {"else", Kind::ELSE},
-      {"false", Kind::FALSE},
-      {"for", Kind::FOR},
-      {"if", Kind::IF},
-      {"in", Kind::IN},
-      {"||", Kind::OR},
-      {"print", Kind::PRINT},
-      {"true", Kind::TRUE},
-      {"let", Kind::LET},
-      {"while", Kind::WHILE},
-  };
-
   std::locale const locale{"C"};
+
+  // Worded like the errors of `Parser`, `line` is the one the unterminated
+  // token starts on
+  auto unterminated(std::string_view const closing, uint32_t const line)
+      -> std::string {
+    return fmt::format(
+        "Syntax error on line {} at end of input: missing {}", line, closing
+    );
+  }
+
+  // Calls `separator(pos, line)` for every `;` separating top-level
+  // statements, `line` being the line it is on. A single pass tracking just
+  // enough state to tell them apart, much cheaper than lexing
+  template <class Separator>
+  auto for_each_separator(std::string_view const source, Separator separator)
+      -> void {
+    enum class State : uint8_t { CODE, STRING, SUBSTITUTION, COMMENT };
+
+    auto state = State::CODE;
+    size_t depth = 0;
+    // Parentheses inside the current substitution, kept apart so that
+    // `depth` is back to the one around it once the substitution closes
+    size_t substitution_depth = 0;
+    uint32_t line = 1;
+
+    for (size_t pos = 0; pos < source.size(); ++pos) {
+      auto const let = source[pos];
+      if (let == '\n') {
+        ++line;
+      }
+      switch (state) {
+      case State::STRING:
+        if (let == '"') {
+          state = State::CODE;
+        }
+        continue;
+      case State::COMMENT:
+        if (let == '\n') {
+          state = State::CODE;
+        }
+        continue;
+      case State::SUBSTITUTION:
+        // Mirrors `read_substitution`, only parentheses matter
+        if (let == '(') {
+          ++substitution_depth;
+        } else if (let == ')' && --substitution_depth == 0) {
+          state = State::CODE;
+        }
+        continue;
+      case State::CODE:
+        break;
+      }
+
+      switch (let) {
+      case '"':
+        state = State::STRING;
+        break;
+      case '%':
+        if (pos + 1 < source.size() && source[pos + 1] == '%') {
+          state = State::COMMENT;
+        }
+        break;
+      case '$':
+        if (pos + 1 < source.size() && source[pos + 1] == '(') {
+          state = State::SUBSTITUTION;
+          substitution_depth = 1;
+          ++pos;
+        }
+        break;
+      case '(':
+      case '[':
+        ++depth;
+        break;
+      case ')':
+      case ']':
+        depth -= depth != 0;
+        break;
+      case ';':
+        if (depth == 0) {
+          separator(pos, line);
+        }
+        break;
+      default:
+        // Loop bodies, `begin ... end`, nest like parentheses. Whole words
+        // are skipped so that e.g. `append` is not taken for `end`
+        if (std::isalpha(let, locale)) {
+          auto const word_end = std::find_if_not(
+              source.begin() + static_cast<ptrdiff_t>(pos), source.end(),
+              [](char const next) { return std::isalpha(next, locale); }
+          );
+          auto const word = std::string_view{
+              source.begin() + static_cast<ptrdiff_t>(pos), word_end
+          };
+          if (word == "begin") {
+            ++depth;
+          } else if (word == "end") {
+            depth -= depth != 0;
+          }
+          pos += word.size() - 1;
+        }
+        break;
+      }
+    }
+  }
 } // namespace
 
 // skip line on comment, getting identifier name
 
-Lexer::Lexer(std::string_view const source) : source_(source) {}
+Lexer::Lexer(std::string_view const source, uint32_t const first_line)
+    : line_(first_line), source_(source) {}
+
+[[nodiscard]] auto Lexer::split(std::string_view const source, size_t count)
+    -> std::vector<Chunk> {
+  count = std::max<size_t>(count, 1);
+  std::vector<Chunk> chunks{};
+  chunks.reserve(count);
+
+  size_t begin = 0;
+  uint32_t first_line = 1;
+  auto target = source.size() / count;
+  for_each_separator(source, [&](size_t const pos, uint32_t const line) {
+    if (pos < target || chunks.size() + 1 >= count) {
+      return;
+    }
+    chunks.push_back({source.substr(begin, pos + 1 - begin), first_line});
+    begin = pos + 1;
+    first_line = line;
+    target = begin + (source.size() - begin) / (count - chunks.size());
+  });
+  chunks.push_back({source.substr(begin), first_line});
+
+  return chunks;
+}
+
+[[nodiscard]] auto Lexer::statements(std::string_view const source)
+    -> std::vector<Chunk> {
+  std::vector<Chunk> chunks{};
+  size_t begin = 0;
+  uint32_t first_line = 1;
+  for_each_separator(source, [&](size_t const pos, uint32_t const line) {
+    chunks.push_back({source.substr(begin, pos + 1 - begin), first_line});
+    begin = pos + 1;
+    first_line = line;
+  });
+  if (begin < source.size()) {
+    chunks.push_back({source.substr(begin), first_line});
+  }
+
+  return chunks;
+}
 
 // TODO: Add '\' for a multi-line expression?
 // TODO: force optional tokens input (in repl mode each line tokens get
@@ -99,16 +218,39 @@ Lexer::receive_tokens(std::optional<std::string_view> const next_source
         tokens.emplace_back(Token::Kind::LESS, line_);
       }
       break;
+    case '.':
+      if (peek_next() == '.') {
+        tokens.emplace_back(Token::Kind::DOT_DOT, line_);
+        advance();
+      } else {
+        tokens.emplace_back(Token::Kind::DOT, line_);
+      }
+      break;
     case '"': {
+      auto const line = line_;
       auto const string = read_string();
-      tokens.emplace_back(Token::Kind::STRING, line_, std::string{string});
+      tokens.emplace_back(Token::Kind::STRING, line, std::string{string});
       break;
     }
+    case '$':
+      if (peek_next() == '(') {
+        auto const line = line_;
+        auto const command = read_substitution();
+        tokens.emplace_back(
+            Token::Kind::SUBSTITUTION, line, std::string{command}
+        );
+      } else {
+        auto const name = read_variable();
+        tokens.emplace_back(Token::Kind::VARIABLE, line_, std::string{name});
+      }
+      break;
     case '%':
-      if (peek_last() == '%') {
+      if (peek_next() == '%') {
         // NOTE: Can be optimized for REPL mode in which it would be considered
         // the end of the current source.
         skip_line();
+        // The newline is left for the `'\n'` case to count
+        continue;
       } else {
         tokens.emplace_back(Token::Kind::PERCENT, line_);
       }
@@ -116,6 +258,22 @@ Lexer::receive_tokens(std::optional<std::string_view> const next_source
     case '\n':
       ++line_;
       break;
+    case '|':
+      if (peek_next() == '|') {
+        tokens.emplace_back(Token::Kind::OR, line_);
+        advance();
+      } else {
+        tokens.emplace_back(Token::Kind::PIPE, line_);
+      }
+      break;
+    case '&':
+      if (peek_next() == '&') {
+        tokens.emplace_back(Token::Kind::AND, line_);
+        advance();
+        break;
+      }
+      // A single `&` is not an operator, it is read like any other character
+      [[fallthrough]];
     default: {
       if (std::isdigit(peek(), locale)) {
         auto const number = read_number();
@@ -124,8 +282,8 @@ Lexer::receive_tokens(std::optional<std::string_view> const next_source
       }
 
       auto const keyword = read_keyword();
-      if (keywords.contains(keyword)) {
-        tokens.emplace_back(keywords[keyword], line_);
+      if (auto const kind = Token::keyword(keyword)) {
+        tokens.emplace_back(kind.value(), line_);
       } else {
         tokens.emplace_back(
             Token::Kind::IDENTIFIER, line_, std::string{keyword}
@@ -179,7 +337,6 @@ auto Lexer::skip_line() -> void {
 [[nodiscard]] auto Lexer::is_whitespace(char const let) -> bool {
   switch (let) {
   case ' ':
-  case '\n':
   case '\r':
   case '\t':
   case '\f':
@@ -193,8 +350,12 @@ auto Lexer::skip_line() -> void {
 // source_'s resources exist
 
 // TODO: Allow digits in identifier's name
+// Punctuation is a single character, `(x` are two tokens
 [[nodiscard]] auto Lexer::read_keyword() -> std::string_view {
   auto const begin = pos_;
+  if (!std::isalpha(peek(), locale)) {
+    return source_.substr(begin, 1);
+  }
   for (; !is_eof() && !is_whitespace(peek_next()); advance()) {
     if (!std::isalpha(peek_next(), locale)) {
       // TODO: Fatal error
@@ -208,24 +369,66 @@ auto Lexer::skip_line() -> void {
 // TODO: Allow single-line strings only
 [[nodiscard]] auto Lexer::read_string() -> std::string_view {
   auto const begin = pos_;
+  auto const line = line_;
 
   advance();
   for (; !is_eof() && peek() != '"'; advance()) {
+    if (peek() == '\n') {
+      ++line_;
+    }
   }
   if (is_eof()) {
-    // set pos to begin
-    // TODO: Syntax error
+    throw std::logic_error(unterminated("\"", line));
   }
 
   return source_.substr(begin + 1, pos_ - 1 - begin);
 }
 
+// Nested parentheses belong to the substituted command, e.g. `$(echo $(ls))`
+[[nodiscard]] auto Lexer::read_substitution() -> std::string_view {
+  advance();
+  auto const begin = pos_;
+  auto const line = line_;
+  auto depth = 1U;
+
+  for (advance(); !is_eof(); advance()) {
+    if (peek() == '\n') {
+      ++line_;
+    } else if (peek() == '(') {
+      ++depth;
+    } else if (peek() == ')' && --depth == 0) {
+      break;
+    }
+  }
+  if (is_eof()) {
+    throw std::logic_error(unterminated(")", line));
+  }
+
+  return source_.substr(begin + 1, pos_ - 1 - begin);
+}
+
+// `$NAME`, names consist of letters, digits and underscores
+[[nodiscard]] auto Lexer::read_variable() -> std::string_view {
+  auto const begin = pos_;
+  for (; !is_eof() && (std::isalnum(peek_next(), locale) || peek_next() == '_');
+       advance()) {
+  }
+
+  return source_.substr(begin + 1, pos_ - begin);
+}
+
+// A decimal point has to be followed by a digit, so `1..5` is a range
 [[nodiscard]] auto Lexer::read_number() -> double {
   auto const begin = pos_;
   bool after_decimal_point = false;
+  auto const is_decimal_point = [this, &after_decimal_point] {
+    return peek_next() == '.' && !after_decimal_point &&
+           pos_ + 2 < source_.size() &&
+           std::isdigit(source_[pos_ + 2], locale);
+  };
 
-  for (; !is_eof() && (std::isdigit(peek_next(), locale) ||
-                       (peek_next() == '.' && !after_decimal_point));
+  for (; !is_eof() &&
+         (std::isdigit(peek_next(), locale) || is_decimal_point());
        advance()) {
     if (peek_next() == '.') {
       after_decimal_point = true;
@@ -8,7 +8,26 @@
 
 class Lexer {
 public:
-  explicit Lexer(std::string_view source = "");
+  // A part of a source which starts and ends between statements
+  struct Chunk {
+    std::string_view source;
+    uint32_t first_line;
+  };
+
+  // `first_line` is the line `source` starts at within the whole script
+  explicit Lexer(std::string_view source = "", uint32_t first_line = 1);
+  // Splits `source` into at most `count` chunks of roughly equal size after
+  // top-level `;`, which can then be lexed and parsed independently.
+  // Separators inside strings, comments, substitutions, parentheses and loop
+  // bodies are skipped
+  [[nodiscard]] static auto split(std::string_view source, size_t count)
+      -> std::vector<Chunk>;
+  // Every top-level statement along with its `;`. Text after the last `;`
+  // is a chunk of its own
+  [[nodiscard]] static auto statements(std::string_view source)
+      -> std::vector<Chunk>;
+  // Throws `std::logic_error` holding the syntax error when a string or a
+  // command substitution is not closed
   [[nodiscard]] auto receive_tokens(
       std::optional<std::string_view> next_source = std::nullopt
   ) -> std::vector<Token>;
@@ -28,6 +47,8 @@ private:
 
   [[nodiscard]] auto read_keyword() -> std::string_view;
   [[nodiscard]] auto read_string() -> std::string_view;
+  [[nodiscard]] auto read_substitution() -> std::string_view;
+  [[nodiscard]] auto read_variable() -> std::string_view;
   [[nodiscard]] auto read_number() -> double;
 
   [[nodiscard]] static auto is_whitespace(char let) -> bool;
@@ -0,0 +1,477 @@
+#include "LineEditor.hpp"
+#include "Environment.hpp"
+#include "Glob.hpp"
+#include "Log.hpp"
+
+#include <algorithm>
+#include <array>
+#include <cctype>
+#include <cerrno>
+#include <cstdio>
+#include <iostream>
+#include <ranges>
+
+#include <fmt/core.h>
+#include <termios.h>
+#include <unistd.h>
+
+namespace {
+  constexpr auto control(char const key) -> char { return key & 0x1f; }
+
+  constexpr char ESCAPE = '\x1b';
+  constexpr char BACKSPACE = 127;
+
+  // Builtins which can not be found in PATH
+  constexpr std::array BUILTINS{"exit", "export", "time", "unset"};
+
+  // Raw mode for the duration of a single `read_line`, so spawned commands
+  // still get a regular terminal
+  class RawMode {
+  public:
+    RawMode() {
+      if (tcgetattr(STDIN_FILENO, &original_) == -1) {
+        return;
+      }
+      auto raw = original_;
+      raw.c_iflag &=
+          ~static_cast<tcflag_t>(BRKINT | ICRNL | INPCK | ISTRIP | IXON);
+      raw.c_cflag |= CS8;
+      raw.c_lflag &= ~static_cast<tcflag_t>(ECHO | ICANON | IEXTEN | ISIG);
+      raw.c_cc[VMIN] = 1;
+      raw.c_cc[VTIME] = 0;
+      enabled_ = tcsetattr(STDIN_FILENO, TCSAFLUSH, &raw) != -1;
+    }
+    RawMode(RawMode const&) = delete;
+    auto operator=(RawMode const&) -> RawMode& = delete;
+    ~RawMode() {
+      if (enabled_) {
+        tcsetattr(STDIN_FILENO, TCSAFLUSH, &original_);
+      }
+    }
+
+  private:
+    termios original_{};
+    bool enabled_ = false;
+  };
+
+  auto read_key() -> std::optional<char> {
+    char key = 0;
+    for (;;) {
+      auto const count = read(STDIN_FILENO, &key, 1);
+      if (count == 1) {
+        return key;
+      }
+      if (count == 0 || errno != EINTR) {
+        return std::nullopt;
+      }
+    }
+  }
+
+  auto write_all(std::string_view text) -> void {
+    while (!text.empty()) {
+      auto const count = write(STDOUT_FILENO, text.data(), text.size());
+      if (count == -1) {
+        if (errno == EINTR) {
+          continue;
+        }
+        return;
+      }
+      text.remove_prefix(static_cast<size_t>(count));
+    }
+  }
+
+  // UTF-8 continuation bytes do not take up a column
+  auto is_continuation(char const let) -> bool {
+    return (static_cast<unsigned char>(let) & 0xC0) == 0x80;
+  }
+
+  auto width(std::string_view const text) -> size_t {
+    return static_cast<size_t>(std::ranges::count_if(text, [](char const let) {
+      return !is_continuation(let);
+    }));
+  }
+
+  auto common_prefix(std::vector<std::string> const& words)
+      -> std::string_view {
+    std::string_view prefix{words.front()};
+    for (std::string_view const word : words) {
+      auto const [mismatch, _] = std::ranges::mismatch(prefix, word);
+      prefix =
+          prefix.substr(0, static_cast<size_t>(mismatch - prefix.begin()));
+    }
+    return prefix;
+  }
+} // namespace
+
+LineEditor::LineEditor(History& history)
+    : history_(history),
+      interactive_(isatty(STDIN_FILENO) == 1 && isatty(STDOUT_FILENO) == 1) {}
+
+[[nodiscard]] auto LineEditor::read_line(std::string_view const prompt)
+    -> std::optional<std::string> {
+  Log::flush();
+  std::fflush(stdout);
+  if (!interactive_) {
+    fmt::print("{}", prompt);
+    std::fflush(stdout);
+    std::string line{};
+    if (!std::getline(std::cin, line)) {
+      return std::nullopt;
+    }
+    return line;
+  }
+
+  RawMode const raw_mode{};
+  prompt_ = prompt;
+  buffer_.clear();
+  cursor_ = 0;
+  history_index_ = history_.size();
+  searching_ = false;
+  listed_completions_ = false;
+  refresh();
+
+  for (;;) {
+    auto const key = read_key();
+    if (!key) {
+      write_all("\n");
+      return std::nullopt;
+    }
+    if (searching_) {
+      if (search_key(key.value())) {
+        refresh();
+        write_all("\n");
+        return buffer_;
+      }
+      refresh();
+      continue;
+    }
+    if (key != '\t') {
+      listed_completions_ = false;
+    }
+
+    switch (key.value()) {
+    case '\r':
+    case '\n':
+      cursor_ = buffer_.size();
+      refresh();
+      write_all("\n");
+      return buffer_;
+    case control('D'):
+      if (buffer_.empty()) {
+        write_all("\n");
+        return std::nullopt;
+      }
+      if (cursor_ < buffer_.size()) {
+        move_right();
+        erase_before_cursor();
+      }
+      break;
+    case control('C'):
+      write_all("^C\n");
+      return std::string{};
+    case BACKSPACE:
+    case control('H'):
+      erase_before_cursor();
+      break;
+    case control('A'):
+      cursor_ = 0;
+      break;
+    case control('E'):
+      cursor_ = buffer_.size();
+      break;
+    case control('B'):
+      move_left();
+      break;
+    case control('F'):
+      move_right();
+      break;
+    case control('K'):
+      buffer_.erase(cursor_);
+      break;
+    case control('U'):
+      buffer_.erase(0, cursor_);
+      cursor_ = 0;
+      break;
+    case control('W'): {
+      auto begin = cursor_;
+      for (; begin > 0 && buffer_[begin - 1] == ' '; --begin) {
+      }
+      for (; begin > 0 && buffer_[begin - 1] != ' '; --begin) {
+      }
+      buffer_.erase(begin, cursor_ - begin);
+      cursor_ = begin;
+      break;
+    }
+    case control('L'):
+      write_all("\x1b[H\x1b[2J");
+      break;
+    case control('P'):
+      if (history_index_ > 0) {
+        recall(history_index_ - 1);
+      }
+      break;
+    case control('N'):
+      recall(history_index_ + 1);
+      break;
+    case control('R'):
+      searching_ = true;
+      edited_ = buffer_;
+      query_.clear();
+      match_.reset();
+      break;
+    case '\t':
+      complete();
+      break;
+    case ESCAPE: {
+      auto const kind = read_key();
+      auto const code = read_key();
+      if (!kind || !code) {
+        break;
+      }
+      auto action = code.value();
+      if (kind == '[' && std::isdigit(static_cast<unsigned char>(action))) {
+        // `ESC [ n ~` sequences
+        if (read_key() != '~') {
+          break;
+        }
+        action = action == '3' ? 'X' : (action == '1' || action == '7') ? 'H'
+                                   : (action == '4' || action == '8') ? 'F'
+                                                                      : '\0';
+      }
+      switch (action) {
+      case 'A':
+        if (history_index_ > 0) {
+          recall(history_index_ - 1);
+        }
+        break;
+      case 'B':
+        recall(history_index_ + 1);
+        break;
+      case 'C':
+        move_right();
+        break;
+      case 'D':
+        move_left();
+        break;
+      case 'H':
+        cursor_ = 0;
+        break;
+      case 'F':
+        cursor_ = buffer_.size();
+        break;
+      case 'X':
+        if (cursor_ < buffer_.size()) {
+          move_right();
+          erase_before_cursor();
+        }
+        break;
+      default:
+        break;
+      }
+      break;
+    }
+    default:
+      if (static_cast<unsigned char>(key.value()) >= ' ') {
+        insert(std::string_view{&key.value(), 1});
+      }
+      break;
+    }
+    refresh();
+  }
+}
+
+// The whole line is composed first and written at once to avoid flickering
+auto LineEditor::refresh() const -> void {
+  std::string frame{"\r"};
+  size_t column = 0;
+  if (searching_) {
+    frame += fmt::format("(reverse-i-search)`{}': ", query_);
+    column = width(frame) - 1 + width(buffer_);
+  } else {
+    frame += prompt_;
+    column = width(prompt_) +
+             width(std::string_view{buffer_}.substr(0, cursor_));
+  }
+  frame += buffer_;
+  frame += "\x1b[K\r";
+  if (column != 0) {
+    frame += fmt::format("\x1b[{}C", column);
+  }
+  write_all(frame);
+}
+
+auto LineEditor::insert(std::string_view const text) -> void {
+  buffer_.insert(cursor_, text);
+  cursor_ += text.size();
+}
+
+auto LineEditor::erase_before_cursor() -> void {
+  auto const end = cursor_;
+  move_left();
+  buffer_.erase(cursor_, end - cursor_);
+}
+
+auto LineEditor::move_left() -> void {
+  while (cursor_ > 0 && is_continuation(buffer_[--cursor_])) {
+  }
+}
+
+auto LineEditor::move_right() -> void {
+  if (cursor_ < buffer_.size()) {
+    ++cursor_;
+  }
+  for (; cursor_ < buffer_.size() && is_continuation(buffer_[cursor_]);
+       ++cursor_) {
+  }
+}
+
+auto LineEditor::recall(size_t const index) -> void {
+  if (index > history_.size()) {
+    return;
+  }
+  if (history_index_ == history_.size()) {
+    edited_ = buffer_;
+  }
+  history_index_ = index;
+  buffer_ = index == history_.size() ? edited_ : history_.at(index);
+  cursor_ = buffer_.size();
+}
+
+auto LineEditor::search_key(char const key) -> bool {
+  auto const newest = history_.size() == 0 ? 0 : history_.size() - 1;
+  switch (key) {
+  case '\r':
+  case '\n':
+    searching_ = false;
+    return true;
+  case control('R'):
+    // Next older match
+    if (match_ && match_.value() > 0) {
+      if (auto const found = history_.search(query_, match_.value() - 1)) {
+        match_ = found;
+      }
+    }
+    break;
+  case BACKSPACE:
+  case control('H'):
+    if (!query_.empty()) {
+      query_.pop_back();
+    }
+    match_ = history_.search(query_, newest);
+    break;
+  case control('G'):
+    searching_ = false;
+    buffer_ = edited_;
+    cursor_ = buffer_.size();
+    return false;
+  default:
+    if (static_cast<unsigned char>(key) < ' ') {
+      // Any other control key keeps the match for editing
+      searching_ = false;
+      return false;
+    }
+    query_ += key;
+    if (auto const found =
+            history_.search(query_, match_.value_or(newest))) {
+      match_ = found;
+    }
+    break;
+  }
+
+  if (match_) {
+    buffer_ = history_.at(match_.value());
+    cursor_ = buffer_.size();
+  }
+  return false;
+}
+
+auto LineEditor::complete() -> void {
+  auto begin = cursor_;
+  for (; begin > 0 && buffer_[begin - 1] != ' '; --begin) {
+  }
+  auto const word = std::string_view{buffer_}.substr(begin, cursor_ - begin);
+  auto const first = buffer_.find_first_not_of(' ') >= begin;
+
+  std::vector<std::string> candidates{};
+  if (first && word.find('/') == std::string_view::npos) {
+    auto const& names = command_names();
+    for (auto it = std::ranges::lower_bound(names, word);
+         it != names.end() && it->starts_with(word); ++it) {
+      candidates.push_back(*it + ' ');
+    }
+  } else {
+    auto const slash = word.rfind('/');
+    auto const found = slash != std::string_view::npos;
+    auto const directory =
+        found ? std::string{word.substr(0, slash + 1)} : std::string{};
+    auto const name = found ? word.substr(slash + 1) : word;
+    Glob::Cache cache{};
+    for (auto const& entry : *cache.list(directory.empty() ? "." : directory)) {
+      if (entry.name.starts_with(name) &&
+          (name.starts_with('.') || !entry.name.starts_with('.'))) {
+        candidates.push_back(
+            directory + entry.name + (entry.directory ? '/' : ' ')
+        );
+      }
+    }
+    std::ranges::sort(candidates);
+  }
+
+  if (candidates.empty()) {
+    write_all("\a");
+    return;
+  }
+  auto const prefix = candidates.size() == 1 ? std::string_view{candidates[0]}
+                                             : common_prefix(candidates);
+  if (prefix.size() > word.size()) {
+    buffer_.replace(begin, word.size(), prefix);
+    cursor_ = begin + prefix.size();
+    return;
+  }
+
+  // Ambiguous: ring first, list the candidates on the second tab
+  if (!listed_completions_) {
+    listed_completions_ = true;
+    write_all("\a");
+    return;
+  }
+  std::string listing{"\n"};
+  for (auto const& candidate : candidates) {
+    auto const trimmed = std::string_view{candidate}.substr(
+        0, candidate.ends_with(' ') ? candidate.size() - 1 : candidate.size()
+    );
+    auto const slash = trimmed.rfind('/', trimmed.size() - 2);
+    listing += trimmed.substr(slash == std::string_view::npos ? 0 : slash + 1);
+    listing += "  ";
+  }
+  listing += '\n';
+  write_all(listing);
+}
+
+[[nodiscard]] auto LineEditor::command_names()
+    -> std::vector<std::string> const& {
+  auto const path = Environment::global().get("PATH").value_or("");
+  if (path == commands_path_ && !commands_.empty()) {
+    return commands_;
+  }
+
+  commands_path_ = path;
+  commands_.assign(BUILTINS.begin(), BUILTINS.end());
+  Glob::Cache cache{};
+  for (auto const& directory : std::views::split(path, ':')) {
+    std::string const name{directory.begin(), directory.end()};
+    if (name.empty()) {
+      continue;
+    }
+    for (auto const& entry : *cache.list(name)) {
+      if (!entry.directory) {
+        commands_.push_back(entry.name);
+      }
+    }
+  }
+  std::ranges::sort(commands_);
+  auto const duplicates = std::ranges::unique(commands_);
+  commands_.erase(duplicates.begin(), duplicates.end());
+
+  return commands_;
+}
@@ -0,0 +1,56 @@
+#pragma once
+#include "History.hpp"
+
+#include <optional>
+#include <string>
+#include <string_view>
+#include <vector>
+
+// Interactive line editing in raw terminal mode: cursor movement, history
+// navigation, incremental reverse search (Ctrl-R) and tab completion of
+// commands and paths. Every keystroke results in a single buffered redraw.
+// Falls back to plain line reading when stdin is not a terminal
+class LineEditor {
+public:
+  explicit LineEditor(History& history);
+
+  // `std::nullopt` on end of input
+  [[nodiscard]] auto read_line(std::string_view prompt)
+      -> std::optional<std::string>;
+
+private:
+  History& history_;
+  bool interactive_;
+
+  std::string prompt_;
+  std::string buffer_;
+  size_t cursor_ = 0;
+
+  // Position while walking through the history, `history_.size()` is the
+  // line being edited
+  size_t history_index_ = 0;
+  std::string edited_;
+
+  // Incremental reverse search state
+  bool searching_ = false;
+  std::string query_;
+  std::optional<size_t> match_;
+
+  // Executables found in PATH, rebuilt when PATH changes
+  std::string commands_path_;
+  std::vector<std::string> commands_;
+  bool listed_completions_ = false;
+
+  auto refresh() const -> void;
+
+  auto insert(std::string_view text) -> void;
+  auto erase_before_cursor() -> void;
+  auto move_left() -> void;
+  auto move_right() -> void;
+  auto recall(size_t index) -> void;
+
+  // Returns true when the key finished the search with the line accepted
+  auto search_key(char key) -> bool;
+  auto complete() -> void;
+  [[nodiscard]] auto command_names() -> std::vector<std::string> const&;
+};
@@ -0,0 +1,219 @@
+#include "Log.hpp"
+
+#include <algorithm>
+#include <array>
+#include <cerrno>
+#include <string>
+#include <thread>
+#include <utility>
+
+#include <fmt/color.h>
+#include <fmt/format.h>
+#include <unistd.h>
+
+namespace {
+  using Log::Level;
+
+  constexpr size_t CAPACITY = 1 << 10;
+  constexpr size_t SLOT_SIZE = Log::MAX_MESSAGE_SIZE;
+  constexpr int OUTPUT = STDOUT_FILENO;
+
+  static_assert((CAPACITY & (CAPACITY - 1)) == 0);
+
+  struct Slot {
+    // Equals the enqueue position once free and that position + 1 once
+    // published
+    std::atomic<size_t> sequence;
+    Level level;
+    bool last;
+    uint16_t size;
+    std::array<char, SLOT_SIZE> text;
+  };
+
+  auto write_all(std::string_view text) -> void {
+    while (!text.empty()) {
+      auto const count = write(OUTPUT, text.data(), text.size());
+      if (count == -1) {
+        if (errno == EINTR) {
+          continue;
+        }
+        return;
+      }
+      text.remove_prefix(static_cast<size_t>(count));
+    }
+  }
+
+  auto append_message(
+      std::string& batch, Level const level, std::string_view const message,
+      bool const colored
+  ) -> void {
+    using namespace fmt;
+    static constexpr std::array PREFIXES{
+        std::pair{"[ERROR]", color::pale_violet_red},
+        std::pair{"[WARNING]", color::yellow},
+        std::pair{"[INFO]", color::sky_blue},
+        std::pair{"[DEBUG]", color::gray},
+    };
+    auto const [prefix, prefix_color] = PREFIXES[std::to_underlying(level)];
+    auto out = std::back_inserter(batch);
+    if (colored) {
+      format_to(out, "{} {}\n", styled(prefix, fg(prefix_color)), message);
+    } else {
+      format_to(out, "{} {}\n", prefix, message);
+    }
+  }
+
+  // Bounded multi-producer ring with a single consumer thread, based on
+  // Dmitry Vyukov's queue. Producers never take a lock, they only wait when
+  // the ring is full
+  class Writer {
+  public:
+    Writer() : colored_(isatty(OUTPUT) == 1) {
+      for (size_t i = 0; i < CAPACITY; ++i) {
+        slots_[i].sequence.store(i, std::memory_order_relaxed);
+      }
+      thread_ = std::thread{[this] { run(); }};
+    }
+    Writer(Writer const&) = delete;
+    auto operator=(Writer const&) -> Writer& = delete;
+    // The writer cannot be woken without publishing something, so closing
+    // pushes a final empty slot and waits for everything before it to drain
+    ~Writer() {
+      auto [slot, pos] = claim();
+      slot.size = 0;
+      slot.last = true;
+      publish(slot, pos);
+      thread_.join();
+    }
+
+    auto push(
+        Level const level, fmt::string_view const format,
+        fmt::format_args const args
+    ) -> void {
+      auto [slot, pos] = claim();
+      auto const result =
+          fmt::vformat_to_n(slot.text.data(), slot.text.size(), format, args);
+      slot.size = static_cast<uint16_t>(std::min(result.size, SLOT_SIZE));
+      if (result.size > SLOT_SIZE) {
+        std::fill_n(slot.text.end() - 3, 3, '.');
+      }
+      slot.level = level;
+      slot.last = false;
+      publish(slot, pos);
+    }
+
+    auto flush() -> void {
+      auto const target = head_.load(std::memory_order_acquire);
+      auto written = written_.load(std::memory_order_acquire);
+      while (written < target) {
+        written_.wait(written, std::memory_order_acquire);
+        written = written_.load(std::memory_order_acquire);
+      }
+    }
+
+  private:
+    alignas(64) std::atomic<size_t> head_{0};
+    alignas(64) std::atomic<size_t> written_{0};
+    std::array<Slot, CAPACITY> slots_{};
+    bool const colored_;
+    std::thread thread_;
+
+    auto claim() -> std::pair<Slot&, size_t> {
+      auto pos = head_.load(std::memory_order_relaxed);
+      for (;;) {
+        auto& slot = slots_[pos & (CAPACITY - 1)];
+        auto const sequence = slot.sequence.load(std::memory_order_acquire);
+        if (sequence == pos) {
+          if (head_.compare_exchange_weak(
+                  pos, pos + 1, std::memory_order_relaxed
+              )) {
+            return {slot, pos};
+          }
+        } else if (sequence < pos) {
+          // Full, let the writer catch up
+          std::this_thread::yield();
+          pos = head_.load(std::memory_order_relaxed);
+        } else {
+          pos = head_.load(std::memory_order_relaxed);
+        }
+      }
+    }
+
+    auto publish(Slot& slot, size_t const pos) -> void {
+      slot.sequence.store(pos + 1, std::memory_order_release);
+      head_.notify_one();
+    }
+
+    auto run() -> void {
+      std::string batch{};
+      size_t tail = 0;
+      for (;;) {
+        // Everything published so far goes out with a single `write`
+        batch.clear();
+        auto const begin = tail;
+        auto closing = false;
+        while (!closing) {
+          auto& slot = slots_[tail & (CAPACITY - 1)];
+          if (slot.sequence.load(std::memory_order_acquire) != tail + 1) {
+            break;
+          }
+          closing = slot.last;
+          if (!closing) {
+            append_message(
+                batch, slot.level, {slot.text.data(), slot.size}, colored_
+            );
+          }
+          slot.sequence.store(tail + CAPACITY, std::memory_order_release);
+          ++tail;
+        }
+        if (tail != begin) {
+          write_all(batch);
+          written_.store(tail, std::memory_order_release);
+          written_.notify_all();
+          if (closing) {
+            return;
+          }
+          continue;
+        }
+
+        auto const head = head_.load(std::memory_order_acquire);
+        if (head != tail) {
+          // Claimed but not published yet
+          std::this_thread::yield();
+          continue;
+        }
+        head_.wait(head, std::memory_order_acquire);
+      }
+    }
+  };
+
+  auto writer() -> Writer& {
+    static Writer instance{};
+    return instance;
+  }
+} // namespace
+
+namespace Log {
+  namespace detail {
+    std::atomic<Level> level{COMPILED_LEVEL};
+
+    auto push(
+        Level const level, fmt::string_view const format,
+        fmt::format_args const args
+    ) -> void {
+      writer().push(level, format, args);
+    }
+  } // namespace detail
+
+  auto set_level(Level const level) -> void {
+    detail::level.store(level, std::memory_order_relaxed);
+  }
+
+  auto flush() -> void { writer().flush(); }
+
+  auto write_now(Level const level, std::string_view const message) -> void {
+    std::string line{};
+    append_message(line, level, message, isatty(OUTPUT) == 1);
+    write_all(line);
+  }
+} // namespace Log
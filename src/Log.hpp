@@ -1,22 +1,76 @@
 #pragma once
 
-#include <fmt/color.h>
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <string_view>
+
 #include <fmt/core.h>
-#include <fmt/format.h>
 
-// TODO: Verbosity settings
+// Levels above `COMPILED_LEVEL` compile away entirely, enabled levels cost a
+// single branch against the runtime level. Messages are formatted on the
+// calling thread, straight into a slot of a lock-free ring buffer, since the
+// arguments are only borrowed for the call. A background thread adds the
+// prefix and writes them out, colored only when the output is a terminal.
 // TODO: Inline reporting in REPL mode
 namespace Log {
-  using namespace fmt;
-  inline constexpr auto error(std::string message) -> void {
-    print("{} {}\n", format(fg(color::pale_violet_red), "[ERROR]"), message);
+  enum class Level : uint8_t { ERROR, WARN, INFO, DEBUG };
+
+  // Size of a ring buffer slot. Longer messages are cut to it, their last
+  // three characters replaced with `...`
+  inline constexpr size_t MAX_MESSAGE_SIZE = 512;
+
+#ifndef SEASHELL_LOG_LEVEL
+#define SEASHELL_LOG_LEVEL 2
+#endif
+  inline constexpr auto COMPILED_LEVEL = static_cast<Level>(SEASHELL_LOG_LEVEL);
+
+  namespace detail {
+    extern std::atomic<Level> level;
+
+    auto push(Level level, fmt::string_view format, fmt::format_args args)
+        -> void;
+  } // namespace detail
+
+  auto set_level(Level level) -> void;
+
+  // Blocks until every message logged so far has been written
+  auto flush() -> void;
+
+  // Writes synchronously, for forked children which do not have the writer
+  // thread
+  auto write_now(Level level, std::string_view message) -> void;
+
+  template <Level LEVEL, class... Args>
+  inline auto log(fmt::format_string<Args...> format, Args&&... args) -> void {
+    if constexpr (LEVEL <= COMPILED_LEVEL) {
+      if (LEVEL <= detail::level.load(std::memory_order_relaxed)) {
+        detail::push(LEVEL, format, fmt::make_format_args(args...));
+      }
+    }
+  }
+
+  template <class... Args>
+  inline auto error(fmt::format_string<Args...> format, Args&&... args)
+      -> void {
+    log<Level::ERROR>(format, std::forward<Args>(args)...);
+  }
+
+  template <class... Args>
+  inline auto warn(fmt::format_string<Args...> format, Args&&... args)
+      -> void {
+    log<Level::WARN>(format, std::forward<Args>(args)...);
   }
 
-  inline constexpr auto warn(std::string message) -> void {
-    print("{} {}\n", format(fg(color::yellow), "[WARNING]"), message);
+  template <class... Args>
+  inline auto info(fmt::format_string<Args...> format, Args&&... args)
+      -> void {
+    log<Level::INFO>(format, std::forward<Args>(args)...);
   }
 
-  inline constexpr auto info(std::string message) -> void {
-    print("{} {}\n", format(fg(color::sky_blue), "[INFO]"), message);
+  template <class... Args>
+  inline auto debug(fmt::format_string<Args...> format, Args&&... args)
+      -> void {
+    log<Level::DEBUG>(format, std::forward<Args>(args)...);
   }
-}
+} // namespace Log
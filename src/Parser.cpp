@@ -1,8 +1,98 @@
 #include "Parser.hpp"
 #include "src/Expr.hpp"
 #include <algorithm>
+#include <array>
+#include <optional>
 #include <fmt/core.h>
 #include <stdexcept>
+#include <string_view>
+#include <utility>
+
+namespace {
+  using Builtin = Expr::Call::Builtin;
+
+  constexpr std::array BUILTINS{
+      std::pair<std::string_view, Builtin>{"sum", Builtin::SUM},
+      std::pair<std::string_view, Builtin>{"min", Builtin::MIN},
+      std::pair<std::string_view, Builtin>{"max", Builtin::MAX},
+      std::pair<std::string_view, Builtin>{"len", Builtin::LEN},
+  };
+
+  [[nodiscard]] auto find_builtin(Token const& name)
+      -> std::pair<std::string_view, Builtin> const* {
+    auto const& spelling = std::get<std::string>(name.literal_.value());
+    auto const* builtin = std::ranges::find(
+        BUILTINS, std::string_view{spelling},
+        [](auto const& entry) { return entry.first; }
+    );
+    if (builtin == BUILTINS.end()) {
+      throw std::logic_error("unknown function");
+    }
+    return builtin;
+  }
+
+  // Binding power of every infix operator, indexed by token kind. Higher
+  // powers bind tighter, tokens without one end an expression
+  constexpr auto INFIX = [] {
+    using Kind = Token::Kind;
+    std::array<uint8_t, std::to_underlying(Kind::Size)> powers{};
+    powers[std::to_underlying(Kind::PIPE)] = 1;
+    powers[std::to_underlying(Kind::OR)] = 2;
+    powers[std::to_underlying(Kind::AND)] = 3;
+    powers[std::to_underlying(Kind::EQUAL_EQUAL)] = 4;
+    powers[std::to_underlying(Kind::BANG_EQUAL)] = 4;
+    powers[std::to_underlying(Kind::LESS)] = 5;
+    powers[std::to_underlying(Kind::LESS_EQUAL)] = 5;
+    powers[std::to_underlying(Kind::GREATER)] = 5;
+    powers[std::to_underlying(Kind::GREATER_EQUAL)] = 5;
+    powers[std::to_underlying(Kind::PLUS)] = 6;
+    powers[std::to_underlying(Kind::MINUS)] = 6;
+    powers[std::to_underlying(Kind::STAR)] = 7;
+    powers[std::to_underlying(Kind::SLASH)] = 7;
+    powers[std::to_underlying(Kind::PERCENT)] = 7;
+    return powers;
+  }();
+
+  // Prefix operators bind tighter than every infix one, `-a * b` is
+  // `(-a) * b`
+  constexpr uint8_t PREFIX = 8;
+
+  // Keeps recursion through arrays, calls and loops far from overflowing the
+  // stack, in every pass over the tree
+  constexpr uint32_t MAX_NESTING = 256;
+
+  // Counts levels of `Parser::nesting_` for as long as it lives, starting
+  // with one
+  class Nested {
+  public:
+    explicit Nested(uint32_t& nesting) : nesting_(nesting) { enter(); }
+    Nested(Nested const&) = delete;
+    auto operator=(Nested const&) -> Nested& = delete;
+    ~Nested() { nesting_ -= levels_; }
+
+    auto enter() -> void {
+      if (nesting_ == MAX_NESTING) {
+        throw std::logic_error("nested too deeply");
+      }
+      ++nesting_;
+      ++levels_;
+    }
+
+  private:
+    uint32_t& nesting_;
+    uint32_t levels_ = 0;
+  };
+
+  // An operator or `(` waiting for the operand on its right
+  struct Pending {
+    // Position of the operator's token
+    size_t operation;
+    // Zero for `(`, which is only closed by `)`
+    uint8_t power;
+    // Only set for binary operators
+    std::optional<Expr::T> left{};
+  };
+} // namespace
 
 // TODO: Return optional while error gets reported here
 [[nodiscard]] auto
@@ -14,12 +104,56 @@ Parser::receive_expressions(std::optional<std::vector<Token>> tokens
   }
 
   try {
-    return expression();
+    auto expr = expression();
+    if (!is_eof()) {
+      throw std::logic_error("unexpected token after expression");
+    }
+    return expr;
   } catch (std::exception const& error) {
+    return syntax_error(error);
+  }
+}
+
+[[nodiscard]] auto
+Parser::receive_statements(std::optional<std::vector<Token>> tokens
+) -> std::variant<std::vector<Expr::T>, std::string> {
+  if (tokens) {
+    tokens_ = std::move(tokens.value());
+    pos_ = 0;
+  }
+
+  std::vector<Expr::T> statements{};
+  try {
+    while (!is_eof()) {
+      if (match_kind({Token::Kind::SEMICOLON})) {
+        continue;
+      }
+      statements.push_back(statement());
+      if (!is_eof() && !match_kind({Token::Kind::SEMICOLON})) {
+        throw std::logic_error("expected ; after expression");
+      }
+    }
+    return statements;
+  } catch (std::exception const& error) {
+    return syntax_error(error);
+  }
+}
+
+[[nodiscard]] auto Parser::syntax_error(std::exception const& error) const
+    -> std::string {
+  if (is_eof()) {
+    if (tokens_.empty()) {
+      return fmt::format("Syntax error at end of input: {}", error.what());
+    }
     return fmt::format(
-        "Syntax error at {}: {}", peek().display(), error.what()
+        "Syntax error on line {} at end of input: {}", tokens_.back().line_,
+        error.what()
     );
   }
+  return fmt::format(
+      "Syntax error on line {} at {}: {}", peek().line_, peek().display(),
+      error.what()
+  );
 }
 
 [[nodiscard]] auto Parser::peek() const -> Token const& {
@@ -61,95 +195,276 @@ Parser::match_kind(std::initializer_list<Token::Kind> const target) -> bool {
   return false;
 }
 
-[[nodiscard]] auto Parser::expression() -> Expr::T { return equality(); }
-
-// TODO: Provide generic method for dealing with left-associative serieses of
-// binary operators
-// TODO: Examine performance changes by 'moving' expressions
-[[nodiscard]] auto Parser::equality() -> Expr::T {
-  auto left = comparison();
-
-  while (match_kind({Token::Kind::BANG_EQUAL, Token::Kind::EQUAL_EQUAL})) {
-    // implicitly copying token
-    auto operation = peek_last();
-    auto right = comparison();
-
-    left = Expr::Binary::init(
-        std::move(left), std::move(operation), std::move(right)
-    );
+[[nodiscard]] auto Parser::make_literal(Token token) -> Expr::T {
+  if (interner_) {
+    return interner_->literal(std::move(token));
   }
+  return Expr::Literal::init(std::move(token));
+}
 
-  return left;
+[[nodiscard]] auto Parser::make_variable(Token name) -> Expr::T {
+  if (interner_) {
+    return interner_->variable(std::move(name));
+  }
+  return Expr::Variable::init(std::move(name));
 }
 
-[[nodiscard]] auto Parser::comparison() -> Expr::T {
-  auto left = term();
+// `((x))` is `(x)`, so redundant parentheses never deepen the tree
+[[nodiscard]] auto Parser::make_grouping(Expr::T expression) -> Expr::T {
+  if (std::holds_alternative<Expr::GroupingPtr>(expression)) {
+    return expression;
+  }
+  if (interner_) {
+    return interner_->grouping(std::move(expression));
+  }
+  return Expr::Grouping::init(std::move(expression));
+}
 
-  using Kind = Token::Kind;
-  while (match_kind(
-      {Kind::LESS, Kind::LESS_EQUAL, Kind::GREATER, Kind::GREATER_EQUAL}
-  )) {
-    auto operation = peek_last();
-    auto right = term();
+[[nodiscard]] auto
+Parser::make_unary(Token operation, Expr::T expression) -> Expr::T {
+  if (interner_) {
+    return interner_->unary(std::move(operation), std::move(expression));
+  }
+  return Expr::Unary::init(std::move(operation), std::move(expression));
+}
 
-    left = Expr::Binary::init(
+[[nodiscard]] auto
+Parser::make_binary(Expr::T left, Token operation, Expr::T right) -> Expr::T {
+  if (interner_) {
+    return interner_->binary(
         std::move(left), std::move(operation), std::move(right)
     );
   }
+  return Expr::Binary::init(
+      std::move(left), std::move(operation), std::move(right)
+  );
+}
 
-  return left;
+[[nodiscard]] auto Parser::statement() -> Expr::T {
+  if (match_kind({Token::Kind::FOR})) {
+    return loop();
+  }
+  if (match_kind({Token::Kind::PRINT})) {
+    auto keyword = peek_last();
+    return Expr::Print::init(std::move(keyword), expression());
+  }
+  return expression();
 }
 
-[[nodiscard]] auto Parser::term() -> Expr::T {
-  auto left = factor();
+[[nodiscard]] auto Parser::loop() -> Expr::T {
+  using Kind = Token::Kind;
+  Nested const nested{nesting_};
+  auto keyword = peek_last();
+  if (!match_kind({Kind::IDENTIFIER})) {
+    throw std::logic_error("expected loop variable after for");
+  }
+  auto name = peek_last();
+  if (!match_kind({Kind::IN})) {
+    throw std::logic_error("expected in after loop variable");
+  }
+  // Parsed before the variable is defined, `for x in 1..x` refers to an
+  // outer `x`
+  auto iterable = expression();
+  std::optional<Expr::T> last{};
+  if (match_kind({Kind::DOT_DOT})) {
+    last = expression();
+  }
+  if (!match_kind({Kind::BEGIN})) {
+    throw std::logic_error("expected begin after loop iterable");
+  }
 
-  while (match_kind({Token::Kind::PLUS, Token::Kind::MINUS})) {
-    auto operation = peek_last();
-    auto right = factor();
+  auto const depth = static_cast<uint32_t>(locals_.size());
+  locals_.push_back(std::get<std::string>(name.literal_.value()));
+  auto statements = body();
+  locals_.pop_back();
+  return Expr::For::init(
+      std::move(keyword), std::move(name), depth, std::move(iterable),
+      std::move(last), std::move(statements)
+  );
+}
 
-    left = Expr::Binary::init(
-        std::move(left), std::move(operation), std::move(right)
-    );
+[[nodiscard]] auto Parser::body() -> std::vector<Expr::T> {
+  using Kind = Token::Kind;
+  std::vector<Expr::T> statements{};
+  while (!match_kind({Kind::END})) {
+    if (is_eof()) {
+      throw std::logic_error("missing end");
+    }
+    if (match_kind({Kind::SEMICOLON})) {
+      continue;
+    }
+    if (match_kind({Kind::BREAK})) {
+      auto keyword = peek_last();
+      std::optional<Expr::T> condition{};
+      if (match_kind({Kind::IF})) {
+        condition = expression();
+      }
+      statements.push_back(
+          Expr::Break::init(std::move(keyword), std::move(condition))
+      );
+    } else {
+      statements.push_back(statement());
+    }
+    if (!is_eof() && peek().kind_ != Kind::END &&
+        !match_kind({Kind::SEMICOLON})) {
+      throw std::logic_error("expected ; after expression");
+    }
   }
-
-  return left;
+  return statements;
 }
-[[nodiscard]] auto Parser::factor() -> Expr::T {
-  auto left = unary();
 
-  while (match_kind({Token::Kind::STAR, Token::Kind::SLASH})) {
-    auto operation = peek_last();
-    auto right = unary();
+// Pratt parsing without recursion. Prefix operators and `(` are pushed until
+// an operand is read, then every pending operator binding at least as tight
+// as the next infix operator takes its right operand, which makes operators
+// of equal power left-associative
+[[nodiscard]] auto Parser::expression() -> Expr::T {
+  using Kind = Token::Kind;
+  std::vector<Pending> pending{};
+  // Every call made by `|` takes everything before it as its argument, so it
+  // nests one level deeper for the rest of the expression
+  std::optional<Nested> pipes{};
+  for (;;) {
+    for (; !is_eof(); advance()) {
+      auto const kind = peek().kind_;
+      if (kind == Kind::LEFT_PAREN) {
+        pending.push_back({.operation = pos_, .power = 0});
+      } else if (kind == Kind::BANG || kind == Kind::MINUS) {
+        pending.push_back({.operation = pos_, .power = PREFIX});
+      } else {
+        break;
+      }
+    }
+    auto operand = primary();
 
-    left = Expr::Binary::init(
-        std::move(left), std::move(operation), std::move(right)
+    auto power = infix_power();
+    for (;; power = infix_power()) {
+      while (!pending.empty() && pending.back().power != 0 &&
+             pending.back().power >= power) {
+        auto& top = pending.back();
+        auto operation = tokens_[top.operation];
+        if (top.left) {
+          operand = make_binary(
+              std::move(top.left.value()), std::move(operation),
+              std::move(operand)
+          );
+        } else {
+          operand = make_unary(std::move(operation), std::move(operand));
+        }
+        pending.pop_back();
+      }
+      if (power != 0) {
+        if (peek().kind_ != Kind::PIPE) {
+          break;
+        }
+        advance();
+        if (pipes) {
+          pipes->enter();
+        } else {
+          pipes.emplace(nesting_);
+        }
+        operand = pipe(std::move(operand));
+        continue;
+      }
+      // Only `(` are left on the stack
+      if (pending.empty()) {
+        return operand;
+      }
+      if (!match_kind({Kind::RIGHT_PAREN})) {
+        throw std::logic_error("missing )");
+      }
+      pending.pop_back();
+      operand = make_grouping(std::move(operand));
+    }
+
+    pending.push_back(
+        {.operation = pos_, .power = power, .left = std::move(operand)}
     );
+    advance();
   }
+}
 
-  return left;
+[[nodiscard]] auto Parser::infix_power() const -> uint8_t {
+  if (is_eof()) {
+    return 0;
+  }
+  return INFIX[std::to_underlying(peek().kind_)];
 }
-// end of left-asso
 
-[[nodiscard]] auto Parser::unary() -> Expr::T {
-  if (match_kind({Token::Kind::BANG, Token::Kind::MINUS})) {
-    auto operation = peek_last();
-    // can't just pass `peek_last` since order of evaluation is unknown
-    return Expr::Unary::init(std::move(operation), unary());
+[[nodiscard]] auto Parser::pipe(Expr::T argument) -> Expr::T {
+  if (is_eof() || peek().kind_ != Token::Kind::IDENTIFIER) {
+    throw std::logic_error("expected function name after |");
   }
-  return primary();
+  auto const* builtin = find_builtin(peek());
+  advance();
+  std::vector<Expr::T> arguments{};
+  arguments.push_back(std::move(argument));
+  return Expr::Call::init(peek_last(), builtin->second, std::move(arguments));
 }
 
 [[nodiscard]] auto Parser::primary() -> Expr::T {
   using Kind = Token::Kind;
   if (match_kind({Kind::TRUE, Kind::FALSE, Kind::STRING, Kind::NUMBER})) {
-    return Expr::Literal::init(peek_last());
+    return make_literal(peek_last());
   }
-  if (match_kind({Kind::LEFT_PAREN})) {
-    auto expr = expression();
-    if (!match_kind({Kind::RIGHT_PAREN})) {
-      throw std::logic_error("missing )");
+  if (match_kind({Kind::SUBSTITUTION})) {
+    return Expr::Substitution::init(peek_last());
+  }
+  if (match_kind({Kind::VARIABLE})) {
+    return make_variable(peek_last());
+  }
+  if (match_kind({Kind::LEFT_BRACE})) {
+    auto bracket = peek_last();
+    auto elements = arguments(Kind::RIGHT_BRACE);
+    return Expr::Array::init(std::move(bracket), std::move(elements));
+  }
+  if (!is_eof() && peek().kind_ == Kind::IDENTIFIER) {
+    // Loop variables shadow functions. They are never interned, the value
+    // changes between iterations
+    auto const& name = std::get<std::string>(peek().literal_.value());
+    auto const local = std::find(locals_.rbegin(), locals_.rend(), name);
+    if (local != locals_.rend()) {
+      auto const depth = static_cast<uint32_t>(locals_.rend() - local - 1);
+      advance();
+      return Expr::Local::init(peek_last(), depth);
     }
-    return Expr::Grouping::init(std::move(expr));
+    return call();
   }
   throw std::logic_error("expected expression");
 }
+
+// Only built-in functions exist so far, all of them take a single argument
+[[nodiscard]] auto Parser::call() -> Expr::T {
+  auto const* builtin = find_builtin(peek());
+  advance();
+  auto callee = peek_last();
+  if (!match_kind({Token::Kind::LEFT_PAREN})) {
+    throw std::logic_error("expected ( after function name");
+  }
+  auto arguments = this->arguments(Token::Kind::RIGHT_PAREN);
+  if (arguments.size() != 1) {
+    throw std::logic_error(
+        fmt::format("{} takes a single argument", builtin->first)
+    );
+  }
+  return Expr::Call::init(
+      std::move(callee), builtin->second, std::move(arguments)
+  );
+}
+
+[[nodiscard]] auto Parser::arguments(Token::Kind const closing)
+    -> std::vector<Expr::T> {
+  Nested const nested{nesting_};
+  std::vector<Expr::T> expressions{};
+  if (match_kind({closing})) {
+    return expressions;
+  }
+  do {
+    expressions.push_back(expression());
+  } while (match_kind({Token::Kind::COMMA}));
+  if (!match_kind({closing})) {
+    throw std::logic_error(fmt::format(
+        "missing {}", closing == Token::Kind::RIGHT_BRACE ? "]" : ")"
+    ));
+  }
+  return expressions;
+}
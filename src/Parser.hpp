@@ -1,8 +1,11 @@
 #pragma once
 #include "Expr.hpp"
+#include "Interner.hpp"
 #include "Token.hpp"
+#include <cstdint>
 #include <initializer_list>
 #include <optional>
+#include <string>
 #include <variant>
 #include <vector>
 
@@ -10,31 +13,72 @@
 // TODO: Take care of empty `tokens` case (just check if empty in `is_eof`?)
 class Parser {
 public:
-  explicit inline Parser(std::vector<Token> tokens)
-      : tokens_(std::move(tokens)) {}
+  // With `hash_consing` structurally equal subexpressions are shared, see
+  // `Interner`
+  explicit inline Parser(std::vector<Token> tokens, bool hash_consing = false)
+      : tokens_(std::move(tokens)) {
+    if (hash_consing) {
+      interner_.emplace();
+    }
+  }
   [[nodiscard]] auto receive_expressions(
       std::optional<std::vector<Token>> tokens = std::nullopt
   ) -> std::variant<Expr::T, std::string>;
+  // Statements are expressions separated by `;`, empty statements are
+  // skipped. Unlike `receive_expressions` an empty input is accepted, since
+  // it might be a part of a larger script
+  [[nodiscard]] auto receive_statements(
+      std::optional<std::vector<Token>> tokens = std::nullopt
+  ) -> std::variant<std::vector<Expr::T>, std::string>;
 
 private:
   std::vector<Token> tokens_;
   size_t pos_ = 0;
+  std::optional<Interner> interner_;
+  // Variables of the loops around the current position, innermost last
+  std::vector<std::string> locals_;
+  // Arrays, calls (including those made by `|`) and loops around the
+  // current position. Unlike operators they are parsed, and later
+  // evaluated, recursively
+  uint32_t nesting_ = 0;
 
   [[nodiscard]] auto peek() const -> Token const&;
   [[nodiscard]] auto peek_last() const -> Token const&;
   [[nodiscard]] auto is_eof() const -> bool;
 
   auto advance() -> void;
+  [[nodiscard]] auto syntax_error(std::exception const& error) const
+      -> std::string;
 
   [[nodiscard]] auto match_kind(std::initializer_list<Token::Kind> target
   ) -> bool;
 
-  // sorted by precedence level
+  // Node construction, going through `interner_` when hash-consing
+  [[nodiscard]] auto make_literal(Token token) -> Expr::T;
+  [[nodiscard]] auto make_variable(Token name) -> Expr::T;
+  [[nodiscard]] auto make_grouping(Expr::T expression) -> Expr::T;
+  [[nodiscard]] auto make_unary(Token operation, Expr::T expression)
+      -> Expr::T;
+  [[nodiscard]] auto make_binary(Expr::T left, Token operation, Expr::T right)
+      -> Expr::T;
+
+  // `for` loops and `print` are only allowed as statements
+  [[nodiscard]] auto statement() -> Expr::T;
+  [[nodiscard]] auto loop() -> Expr::T;
+  // Statements up to and including `end`, `break` is allowed among them
+  [[nodiscard]] auto body() -> std::vector<Expr::T>;
+
+  // Operators and parentheses are parsed with an explicit stack driven by a
+  // table of binding powers, so neither the nesting depth nor the number of
+  // precedence levels costs any native stack
   [[nodiscard]] auto expression() -> Expr::T;
-  [[nodiscard]] auto equality() -> Expr::T;
-  [[nodiscard]] auto comparison() -> Expr::T;
-  [[nodiscard]] auto term() -> Expr::T;
-  [[nodiscard]] auto factor() -> Expr::T;
-  [[nodiscard]] auto unary() -> Expr::T;
+  // Binding power of the infix operator at the current position, zero when
+  // there is none
+  [[nodiscard]] auto infix_power() const -> uint8_t;
+  // `value | name` calls the built-in function `name` on `value`
+  [[nodiscard]] auto pipe(Expr::T argument) -> Expr::T;
   [[nodiscard]] auto primary() -> Expr::T;
+  [[nodiscard]] auto call() -> Expr::T;
+  // Comma separated expressions up to and including `closing`
+  [[nodiscard]] auto arguments(Token::Kind closing) -> std::vector<Expr::T>;
 };
@@ -0,0 +1,115 @@
+#include "Seashell.hpp"
+#include "Interner.hpp"
+#include "Lexer.hpp"
+#include "Log.hpp"
+#include "Parser.hpp"
+#include "Typing.hpp"
+
+#include <algorithm>
+#include <future>
+#include <iterator>
+#include <ranges>
+#include <stdexcept>
+#include <string>
+#include <variant>
+#include <vector>
+
+namespace {
+  // Smaller chunks are not worth a thread
+  constexpr size_t MIN_CHUNK_SIZE = 1 << 20;
+
+  using Statements = std::variant<std::vector<Expr::T>, std::string>;
+
+  auto compile_chunk(Lexer::Chunk const chunk, bool const hash_consing)
+      -> Statements {
+    Lexer lexer{chunk.source, chunk.first_line};
+    std::vector<Token> tokens{};
+    try {
+      tokens = lexer.receive_tokens();
+    } catch (std::logic_error const& error) {
+      return error.what();
+    }
+    Parser parser{std::move(tokens), hash_consing};
+    auto result = parser.receive_statements();
+    if (auto* statements = std::get_if<std::vector<Expr::T>>(&result)) {
+      for (auto const& statement : *statements) {
+        Typing::infer(statement);
+      }
+    }
+    return result;
+  }
+
+  // Chunks never share nodes with each other, so hash-consing only finds
+  // duplicates within a chunk
+  auto compile_parallel(
+      std::string_view const source, size_t const threads,
+      bool const hash_consing
+  ) -> Statements {
+    auto const chunks = Lexer::split(source, threads);
+    std::vector<std::future<Statements>> results{};
+    results.reserve(chunks.size());
+    // The calling thread takes the first chunk itself
+    for (auto const& chunk : chunks | std::views::drop(1)) {
+      results.push_back(
+          std::async(std::launch::async, compile_chunk, chunk, hash_consing)
+      );
+    }
+
+    auto first = compile_chunk(chunks.front(), hash_consing);
+    if (std::holds_alternative<std::string>(first)) {
+      return first;
+    }
+    auto& statements = std::get<std::vector<Expr::T>>(first);
+    for (auto& future : results) {
+      auto result = future.get();
+      if (std::holds_alternative<std::string>(result)) {
+        return result;
+      }
+      std::ranges::move(
+          std::get<std::vector<Expr::T>>(result),
+          std::back_inserter(statements)
+      );
+    }
+    return first;
+  }
+} // namespace
+
+namespace Seashell {
+  [[nodiscard]] auto Program::compile(
+      std::string_view const source, Sink const& sink, Options const options
+  ) -> std::optional<Program> {
+    auto const threads = std::min<size_t>(
+        source.size() / MIN_CHUNK_SIZE, options.front_end_threads
+    );
+    auto result =
+        threads > 1
+            ? compile_parallel(source, threads, options.share_subexpressions)
+            : compile_chunk(
+                  {.source = source, .first_line = 1},
+                  options.share_subexpressions
+              );
+    if (auto const* statements = std::get_if<std::vector<Expr::T>>(&result);
+        statements != nullptr && statements->empty()) {
+      result = "Syntax error at end of input: expected expression";
+    }
+    if (auto const* error = std::get_if<std::string>(&result)) {
+      if (sink) {
+        sink(*error);
+      } else {
+        Log::error("{}", *error);
+      }
+      return std::nullopt;
+    }
+
+    auto statements = std::get<std::vector<Expr::T>>(std::move(result));
+    auto const slots = options.share_subexpressions
+                           ? Interner::assign_slots(statements)
+                           : 0;
+    return Program{std::move(statements), slots};
+  }
+
+  [[nodiscard]] auto Program::eval(Context& context
+  ) const -> std::optional<Literal> {
+    return context.interpreter_.eval(*statements_, slots_);
+  }
+} // namespace Seashell
@@ -0,0 +1,68 @@
+#pragma once
+#include "Expr.hpp"
+#include "Interpreter.hpp"
+
+#include <memory>
+#include <optional>
+#include <string_view>
+#include <vector>
+
+// Embedding interface of libseashell.
+// A `Program` is compiled once and never modified afterwards, therefore a
+// single instance can be shared and evaluated concurrently by several
+// threads as long as every thread uses its own `Context`.
+// Expressions known when the host is compiled can be compiled along with it,
+// see `Static.hpp`.
+namespace Seashell {
+  using Literal = Interpreter::Literal;
+  using Sink = Interpreter::Sink;
+
+  // Per-thread evaluation state. Cheap to create, but not meant to be shared
+  // between threads
+  class Context {
+  public:
+    inline explicit Context(Sink sink = {}) : interpreter_(std::move(sink)) {}
+
+  private:
+    friend class Program;
+    Interpreter interpreter_;
+  };
+
+  struct Options {
+    // Share structurally equal subexpressions and evaluate repeated pure
+    // subexpressions once per evaluation. Pays off for generated scripts
+    // with a lot of duplication
+    bool share_subexpressions = false;
+    // Large sources are split between statements and lexed and parsed on up
+    // to this many threads
+    unsigned front_end_threads = 1;
+  };
+
+  class Program {
+  public:
+    // A program is a sequence of `;` separated statements, evaluating to the
+    // value of the last one. Errors are reported to `sink` (or logged when no
+    // sink is given)
+    [[nodiscard]] static auto compile(
+        std::string_view source, Sink const& sink = {}, Options options = {}
+    ) -> std::optional<Program>;
+
+    [[nodiscard]] auto eval(Context& context) const -> std::optional<Literal>;
+
+  private:
+    inline explicit Program(
+        std::vector<Expr::T> statements, uint32_t const slots
+    )
+        : statements_(std::make_shared<std::vector<Expr::T> const>(
+              std::move(statements)
+          )),
+          slots_(slots) {}
+
+    std::shared_ptr<std::vector<Expr::T> const> statements_;
+    uint32_t slots_;
+  };
+
+  inline auto display(Literal const& literal) -> std::string {
+    return Interpreter::display(literal);
+  }
+} // namespace Seashell
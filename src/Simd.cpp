@@ -0,0 +1,269 @@
+#include "Simd.hpp"
+
+#include <array>
+#include <cstddef>
+#include <utility>
+
+// Built with `-O3` regardless of the build type (see meson.build), the
+// loops below are written to be auto-vectorized
+#if defined(__x86_64__) && !defined(__clang__)
+#define SEASHELL_CLONES                                                        \
+  __attribute__((target_clones("avx512f", "avx2", "default")))
+#else
+#define SEASHELL_CLONES
+#endif
+
+namespace {
+  using Simd::Operation;
+
+  // Independent accumulators, letting reductions run in vector registers
+  // without reassociating floating point additions behind the compiler's back
+  constexpr size_t LANES = 8;
+
+  template <class T> struct Wrapping;
+
+  template <> struct Wrapping<double> {
+    using Type = double;
+  };
+
+  // Signed overflow is undefined, unsigned arithmetic wraps
+  template <> struct Wrapping<int64_t> {
+    using Type = uint64_t;
+  };
+
+  template <class T, class Left, class Right, class Out, class Operator>
+  [[gnu::always_inline]] inline auto each(
+      Left const left, Right const right, Out* const out, size_t const size,
+      Operator const operation
+  ) -> void {
+    for (size_t i = 0; i < size; ++i) {
+      out[i] = operation(left(i), right(i));
+    }
+  }
+
+  template <class T, class Left, class Right>
+  [[gnu::always_inline]] inline auto dispatch_arithmetic(
+      Operation const operation, Left const left, Right const right, T* out,
+      size_t const size
+  ) -> void {
+    using W = Wrapping<T>::Type;
+    auto const wrap = [](auto const value) { return static_cast<W>(value); };
+    switch (operation) {
+    case Operation::ADD:
+      return each<T>(left, right, out, size, [wrap](T a, T b) {
+        return static_cast<T>(wrap(a) + wrap(b));
+      });
+    case Operation::SUBTRACT:
+      return each<T>(left, right, out, size, [wrap](T a, T b) {
+        return static_cast<T>(wrap(a) - wrap(b));
+      });
+    case Operation::MULTIPLY:
+      return each<T>(left, right, out, size, [wrap](T a, T b) {
+        return static_cast<T>(wrap(a) * wrap(b));
+      });
+    case Operation::DIVIDE:
+      return each<T>(left, right, out, size, [](T a, T b) { return a / b; });
+    default:
+      std::unreachable();
+    }
+  }
+
+  template <class T, class Left, class Right>
+  [[gnu::always_inline]] inline auto dispatch_compare(
+      Operation const operation, Left const left, Right const right,
+      int64_t* out, size_t const size
+  ) -> void {
+    auto const compare = [&](auto const predicate) {
+      each<T>(left, right, out, size, [predicate](T a, T b) {
+        return static_cast<int64_t>(predicate(a, b));
+      });
+    };
+    switch (operation) {
+    case Operation::LESS:
+      return compare([](T a, T b) { return a < b; });
+    case Operation::LESS_EQUAL:
+      return compare([](T a, T b) { return a <= b; });
+    case Operation::GREATER:
+      return compare([](T a, T b) { return a > b; });
+    case Operation::GREATER_EQUAL:
+      return compare([](T a, T b) { return a >= b; });
+    case Operation::EQUAL:
+      return compare([](T a, T b) { return a == b; });
+    case Operation::NOT_EQUAL:
+      return compare([](T a, T b) { return a != b; });
+    default:
+      std::unreachable();
+    }
+  }
+
+  template <class T>
+  [[gnu::always_inline]] inline auto elements(T const* data) {
+    return [data](size_t const i) { return data[i]; };
+  }
+
+  template <class T>
+  [[gnu::always_inline]] inline auto scalar(T const value) {
+    return [value](size_t) { return value; };
+  }
+
+  template <class T, class Step>
+  [[gnu::always_inline]] inline auto
+  reduce(std::span<T const> const values, T const initial, Step const step)
+      -> T {
+    std::array<T, LANES> lanes{};
+    lanes.fill(initial);
+    auto const whole = values.size() - (values.size() % LANES);
+    for (size_t i = 0; i < whole; i += LANES) {
+      for (size_t lane = 0; lane < LANES; ++lane) {
+        lanes[lane] = step(lanes[lane], values[i + lane]);
+      }
+    }
+    for (size_t i = whole; i < values.size(); ++i) {
+      lanes[0] = step(lanes[0], values[i]);
+    }
+    auto result = lanes[0];
+    for (size_t lane = 1; lane < LANES; ++lane) {
+      result = step(result, lanes[lane]);
+    }
+    return result;
+  }
+} // namespace
+
+namespace Simd {
+  SEASHELL_CLONES auto arithmetic(
+      Operation const operation, std::span<double const> const left,
+      std::span<double const> const right, std::span<double> const out
+  ) -> void {
+    dispatch_arithmetic<double>(
+        operation, elements(left.data()), elements(right.data()), out.data(),
+        out.size()
+    );
+  }
+
+  SEASHELL_CLONES auto arithmetic(
+      Operation const operation, std::span<double const> const left,
+      double const right, std::span<double> const out
+  ) -> void {
+    dispatch_arithmetic<double>(
+        operation, elements(left.data()), scalar(right), out.data(),
+        out.size()
+    );
+  }
+
+  SEASHELL_CLONES auto arithmetic(
+      Operation const operation, double const left,
+      std::span<double const> const right, std::span<double> const out
+  ) -> void {
+    dispatch_arithmetic<double>(
+        operation, scalar(left), elements(right.data()), out.data(),
+        out.size()
+    );
+  }
+
+  SEASHELL_CLONES auto arithmetic(
+      Operation const operation, std::span<int64_t const> const left,
+      std::span<int64_t const> const right, std::span<int64_t> const out
+  ) -> void {
+    dispatch_arithmetic<int64_t>(
+        operation, elements(left.data()), elements(right.data()), out.data(),
+        out.size()
+    );
+  }
+
+  SEASHELL_CLONES auto arithmetic(
+      Operation const operation, std::span<int64_t const> const left,
+      int64_t const right, std::span<int64_t> const out
+  ) -> void {
+    dispatch_arithmetic<int64_t>(
+        operation, elements(left.data()), scalar(right), out.data(),
+        out.size()
+    );
+  }
+
+  SEASHELL_CLONES auto arithmetic(
+      Operation const operation, int64_t const left,
+      std::span<int64_t const> const right, std::span<int64_t> const out
+  ) -> void {
+    dispatch_arithmetic<int64_t>(
+        operation, scalar(left), elements(right.data()), out.data(),
+        out.size()
+    );
+  }
+
+  SEASHELL_CLONES auto compare(
+      Operation const operation, std::span<double const> const left,
+      std::span<double const> const right, std::span<int64_t> const out
+  ) -> void {
+    dispatch_compare<double>(
+        operation, elements(left.data()), elements(right.data()), out.data(),
+        out.size()
+    );
+  }
+
+  SEASHELL_CLONES auto compare(
+      Operation const operation, std::span<double const> const left,
+      double const right, std::span<int64_t> const out
+  ) -> void {
+    dispatch_compare<double>(
+        operation, elements(left.data()), scalar(right), out.data(),
+        out.size()
+    );
+  }
+
+  SEASHELL_CLONES auto compare(
+      Operation const operation, std::span<int64_t const> const left,
+      std::span<int64_t const> const right, std::span<int64_t> const out
+  ) -> void {
+    dispatch_compare<int64_t>(
+        operation, elements(left.data()), elements(right.data()), out.data(),
+        out.size()
+    );
+  }
+
+  SEASHELL_CLONES auto compare(
+      Operation const operation, std::span<int64_t const> const left,
+      int64_t const right, std::span<int64_t> const out
+  ) -> void {
+    dispatch_compare<int64_t>(
+        operation, elements(left.data()), scalar(right), out.data(),
+        out.size()
+    );
+  }
+
+  SEASHELL_CLONES auto sum(std::span<double const> const values) -> double {
+    return reduce(values, 0.0, [](double a, double b) { return a + b; });
+  }
+
+  SEASHELL_CLONES auto sum(std::span<int64_t const> const values) -> int64_t {
+    return reduce(values, int64_t{0}, [](int64_t a, int64_t b) {
+      return static_cast<int64_t>(
+          static_cast<uint64_t>(a) + static_cast<uint64_t>(b)
+      );
+    });
+  }
+
+  // Written as selects, which map onto vector min and max instructions
+  SEASHELL_CLONES auto min(std::span<double const> const values) -> double {
+    return reduce(values, values.front(), [](double a, double b) {
+      return b < a ? b : a;
+    });
+  }
+
+  SEASHELL_CLONES auto min(std::span<int64_t const> const values) -> int64_t {
+    return reduce(values, values.front(), [](int64_t a, int64_t b) {
+      return b < a ? b : a;
+    });
+  }
+
+  SEASHELL_CLONES auto max(std::span<double const> const values) -> double {
+    return reduce(values, values.front(), [](double a, double b) {
+      return b > a ? b : a;
+    });
+  }
+
+  SEASHELL_CLONES auto max(std::span<int64_t const> const values) -> int64_t {
+    return reduce(values, values.front(), [](int64_t a, int64_t b) {
+      return b > a ? b : a;
+    });
+  }
+} // namespace Simd
@@ -0,0 +1,84 @@
+#pragma once
+
+#include <cstdint>
+#include <span>
+
+// Element-wise kernels over contiguous numbers. Every kernel is compiled for
+// several instruction sets and the best one for the host CPU is picked when
+// the program is loaded (`target_clones`), so the interpreter never branches
+// on CPU features itself.
+// Outputs have the size of the inputs, array operands have equal sizes.
+namespace Simd {
+  enum class Operation : uint8_t {
+    ADD,
+    SUBTRACT,
+    MULTIPLY,
+    DIVIDE,
+    LESS,
+    LESS_EQUAL,
+    GREATER,
+    GREATER_EQUAL,
+    EQUAL,
+    NOT_EQUAL,
+  };
+
+  [[nodiscard]] constexpr auto is_comparison(Operation const operation)
+      -> bool {
+    return operation >= Operation::LESS;
+  }
+
+  // Arithmetic. Integers wrap around on overflow and are never divided, the
+  // caller converts them to doubles first and checks that results fit
+  auto arithmetic(
+      Operation operation, std::span<double const> left,
+      std::span<double const> right, std::span<double> out
+  ) -> void;
+  auto arithmetic(
+      Operation operation, std::span<double const> left, double right,
+      std::span<double> out
+  ) -> void;
+  auto arithmetic(
+      Operation operation, double left, std::span<double const> right,
+      std::span<double> out
+  ) -> void;
+  auto arithmetic(
+      Operation operation, std::span<int64_t const> left,
+      std::span<int64_t const> right, std::span<int64_t> out
+  ) -> void;
+  auto arithmetic(
+      Operation operation, std::span<int64_t const> left, int64_t right,
+      std::span<int64_t> out
+  ) -> void;
+  auto arithmetic(
+      Operation operation, int64_t left, std::span<int64_t const> right,
+      std::span<int64_t> out
+  ) -> void;
+
+  // Comparisons, producing 1 for true and 0 for false
+  auto compare(
+      Operation operation, std::span<double const> left,
+      std::span<double const> right, std::span<int64_t> out
+  ) -> void;
+  auto compare(
+      Operation operation, std::span<double const> left, double right,
+      std::span<int64_t> out
+  ) -> void;
+  auto compare(
+      Operation operation, std::span<int64_t const> left,
+      std::span<int64_t const> right, std::span<int64_t> out
+  ) -> void;
+  auto compare(
+      Operation operation, std::span<int64_t const> left, int64_t right,
+      std::span<int64_t> out
+  ) -> void;
+
+  // Reductions. Floating point sums are accumulated in a fixed number of
+  // lanes, so they are identical on every instruction set
+  [[nodiscard]] auto sum(std::span<double const> values) -> double;
+  [[nodiscard]] auto sum(std::span<int64_t const> values) -> int64_t;
+  // Non-empty inputs only
+  [[nodiscard]] auto min(std::span<double const> values) -> double;
+  [[nodiscard]] auto min(std::span<int64_t const> values) -> int64_t;
+  [[nodiscard]] auto max(std::span<double const> values) -> double;
+  [[nodiscard]] auto max(std::span<int64_t const> values) -> int64_t;
+} // namespace Simd
@@ -0,0 +1,497 @@
+#pragma once
+#include "Token.hpp"
+
+#include <algorithm>
+#include <array>
+#include <concepts>
+#include <cstddef>
+#include <cstdint>
+#include <initializer_list>
+#include <stdexcept>
+#include <string_view>
+#include <type_traits>
+
+// Compile-time front end for expressions embedded in C++ code:
+//
+//   constexpr auto area = Seashell::compile<"width * height / 2">();
+//   auto const value = area(3.0, 4.0); // 6
+//
+// The expression is lexed, parsed and type checked while the host is being
+// compiled, so syntax and type errors are compile errors and nothing of the
+// front end is left at runtime. The evaluator is instantiated for every node
+// of the parsed tree, which leaves plain arithmetic to the optimizer.
+// Identifiers are the parameters of the expression (numbers), in order of
+// their first appearance. Only numbers and booleans exist at compile time,
+// strings, arrays, variables and commands need a runtime `Program`.
+// Errors show up as a `throw` which is not a constant expression, the line
+// the compiler points at has the message.
+namespace Seashell {
+  // String literal usable as a template argument
+  template <size_t N> struct FixedString {
+    std::array<char, N> data{};
+
+    // Implicit, so that `compile<"...">` works
+    consteval FixedString(char const (&text)[N]) {
+      std::copy_n(text, N, data.begin());
+    }
+
+    [[nodiscard]] constexpr auto view() const -> std::string_view {
+      return {data.data(), N - 1};
+    }
+  };
+
+  namespace Static {
+    enum class Type : uint8_t { NUMBER, BOOL };
+
+    struct Node {
+      enum class Kind : uint8_t { NUMBER, BOOL, PARAMETER, UNARY, BINARY };
+
+      Kind kind = Kind::NUMBER;
+      Type type = Type::NUMBER;
+      Token::Kind operation = Token::Kind::Size;
+      double number = 0;
+      bool boolean = false;
+      uint32_t parameter = 0;
+      // Operands, indices into `Tree::nodes`
+      uint32_t left = 0;
+      uint32_t right = 0;
+    };
+
+    // Position of a parameter's name in the source
+    struct Name {
+      uint32_t begin = 0;
+      uint32_t length = 0;
+    };
+
+    // Parsed expression, usable as a template argument. A source of `N - 1`
+    // characters never has more than that many nodes or parameters
+    template <size_t N> struct Tree {
+      std::array<Node, N> nodes{};
+      uint32_t size = 0;
+      uint32_t root = 0;
+      std::array<Name, N> names{};
+      uint32_t parameters = 0;
+      Type type = Type::NUMBER;
+    };
+
+    struct Lexeme {
+      Token::Kind kind = Token::Kind::Size;
+      double number = 0;
+      uint32_t begin = 0;
+      uint32_t length = 0;
+    };
+
+    // NOTE: `<cctype>` is not usable in constant expressions
+    constexpr auto is_digit(char const let) -> bool {
+      return let >= '0' && let <= '9';
+    }
+
+    constexpr auto is_alpha(char const let) -> bool {
+      return (let >= 'a' && let <= 'z') || (let >= 'A' && let <= 'Z');
+    }
+
+    // Same rules as `Lexer`, minus the tokens only the runtime can evaluate
+    template <size_t N> class Lexer {
+    public:
+      constexpr explicit Lexer(std::string_view const source)
+          : source_(source) {}
+
+      constexpr auto receive_lexemes() -> std::array<Lexeme, N> {
+        using Kind = Token::Kind;
+        std::array<Lexeme, N> lexemes{};
+        size_t size = 0;
+        auto const emit = [&](Kind const kind, size_t const begin) {
+          lexemes[size++] = Lexeme{
+              .kind = kind,
+              .number = 0,
+              .begin = static_cast<uint32_t>(begin),
+              .length = static_cast<uint32_t>(pos_ - begin)
+          };
+        };
+
+        while (pos_ < source_.size()) {
+          auto const begin = pos_;
+          auto const let = source_[pos_++];
+          switch (let) {
+          case ' ':
+          case '\r':
+          case '\t':
+          case '\f':
+          case '\n':
+            continue;
+          case '=':
+          case '!':
+          case '>':
+          case '<': {
+            auto const equal = match('=');
+            emit(compare(let, equal), begin);
+            continue;
+          }
+          case '.':
+            emit(match('.') ? Kind::DOT_DOT : Kind::DOT, begin);
+            continue;
+          case '%':
+            if (!match('%')) {
+              emit(Kind::PERCENT, begin);
+              continue;
+            }
+            while (pos_ < source_.size() && source_[pos_] != '\n') {
+              ++pos_;
+            }
+            continue;
+          case '"':
+            throw std::logic_error("strings need the runtime interpreter");
+          case '$':
+            throw std::logic_error("$ expansions need the runtime interpreter");
+          default:
+            break;
+          }
+
+          if (is_digit(let)) {
+            auto const number = read_number(begin);
+            emit(Kind::NUMBER, begin);
+            lexemes[size - 1].number = number;
+            continue;
+          }
+          if (is_alpha(let)) {
+            while (pos_ < source_.size() && is_alpha(source_[pos_])) {
+              ++pos_;
+            }
+          }
+          auto const spelling = source_.substr(begin, pos_ - begin);
+          if (auto const kind = Token::keyword(spelling)) {
+            emit(kind.value(), begin);
+          } else if (is_alpha(let)) {
+            emit(Kind::IDENTIFIER, begin);
+          } else {
+            throw std::logic_error("unexpected character");
+          }
+        }
+        return lexemes;
+      }
+
+    private:
+      std::string_view source_;
+      size_t pos_ = 0;
+
+      constexpr auto match(char const expected) -> bool {
+        if (pos_ < source_.size() && source_[pos_] == expected) {
+          ++pos_;
+          return true;
+        }
+        return false;
+      }
+
+      static constexpr auto compare(char const let, bool const equal)
+          -> Token::Kind {
+        using Kind = Token::Kind;
+        switch (let) {
+        case '=':
+          return equal ? Kind::EQUAL_EQUAL : Kind::EQUAL;
+        case '!':
+          return equal ? Kind::BANG_EQUAL : Kind::BANG;
+        case '>':
+          return equal ? Kind::GREATER_EQUAL : Kind::GREATER;
+        default:
+          return equal ? Kind::LESS_EQUAL : Kind::LESS;
+        }
+      }
+
+      // Digits are accumulated as an integer and scaled once at the end,
+      // which rounds correctly as long as both fit a double exactly
+      constexpr auto read_number(size_t const begin) -> double {
+        double mantissa = source_[begin] - '0';
+        double scale = 1;
+        auto after_decimal_point = false;
+        for (; pos_ < source_.size(); ++pos_) {
+          auto const let = source_[pos_];
+          if (let == '.' && !after_decimal_point &&
+              pos_ + 1 < source_.size() && is_digit(source_[pos_ + 1])) {
+            after_decimal_point = true;
+            continue;
+          }
+          if (!is_digit(let)) {
+            break;
+          }
+          mantissa = mantissa * 10 + (let - '0');
+          if (after_decimal_point) {
+            scale *= 10;
+          }
+        }
+        return mantissa / scale;
+      }
+    };
+
+    // Recursive descent with the binding powers of `::Parser` for the
+    // operators it supports (no `%`, `&&`, `||` or `|` yet), checking operand
+    // types the way `Interpreter` does at runtime
+    template <size_t N> class Parser {
+    public:
+      constexpr explicit Parser(std::string_view const source)
+          : source_(source), lexemes_(Lexer<N>{source}.receive_lexemes()) {
+        while (count_ < N && lexemes_[count_].kind != Token::Kind::Size) {
+          ++count_;
+        }
+      }
+
+      constexpr auto receive_tree() -> Tree<N> {
+        tree_.root = expression();
+        if (pos_ != count_) {
+          throw std::logic_error("unexpected token after expression");
+        }
+        tree_.type = tree_.nodes[tree_.root].type;
+        return tree_;
+      }
+
+    private:
+      using Kind = Token::Kind;
+
+      std::string_view source_;
+      std::array<Lexeme, N> lexemes_;
+      size_t count_ = 0;
+      size_t pos_ = 0;
+      Tree<N> tree_{};
+
+      constexpr auto match(std::initializer_list<Kind> const kinds) -> bool {
+        if (pos_ < count_ && std::ranges::find(kinds, lexemes_[pos_].kind) !=
+                                 kinds.end()) {
+          ++pos_;
+          return true;
+        }
+        return false;
+      }
+
+      [[nodiscard]] constexpr auto last() const -> Lexeme const& {
+        return lexemes_[pos_ - 1];
+      }
+
+      constexpr auto add(Node const node) -> uint32_t {
+        tree_.nodes[tree_.size] = node;
+        return tree_.size++;
+      }
+
+      constexpr auto binary(Kind const operation, uint32_t left, uint32_t right)
+          -> uint32_t {
+        auto const left_type = tree_.nodes[left].type;
+        if (left_type != tree_.nodes[right].type) {
+          throw std::logic_error("operands of different types");
+        }
+        auto type = Type::BOOL;
+        switch (operation) {
+        case Kind::PLUS:
+        case Kind::MINUS:
+        case Kind::STAR:
+        case Kind::SLASH:
+          type = Type::NUMBER;
+          [[fallthrough]];
+        case Kind::GREATER:
+        case Kind::GREATER_EQUAL:
+        case Kind::LESS:
+        case Kind::LESS_EQUAL:
+        case Kind::EQUAL_EQUAL:
+        case Kind::BANG_EQUAL:
+          // Booleans are only operands of `!` at runtime
+          if (left_type != Type::NUMBER) {
+            throw std::logic_error("operation only avaliable for numbers");
+          }
+          break;
+        default:
+          throw std::logic_error("unsupported binary operation");
+        }
+        return add(Node{
+            .kind = Node::Kind::BINARY,
+            .type = type,
+            .operation = operation,
+            .left = left,
+            .right = right
+        });
+      }
+
+      template <class Operand>
+      constexpr auto
+      left_associative(std::initializer_list<Kind> const kinds, Operand operand)
+          -> uint32_t {
+        auto left = operand();
+        while (match(kinds)) {
+          auto const operation = last().kind;
+          left = binary(operation, left, operand());
+        }
+        return left;
+      }
+
+      constexpr auto expression() -> uint32_t { return equality(); }
+
+      constexpr auto equality() -> uint32_t {
+        return left_associative({Kind::BANG_EQUAL, Kind::EQUAL_EQUAL}, [this] {
+          return comparison();
+        });
+      }
+
+      constexpr auto comparison() -> uint32_t {
+        return left_associative(
+            {Kind::LESS, Kind::LESS_EQUAL, Kind::GREATER, Kind::GREATER_EQUAL},
+            [this] { return term(); }
+        );
+      }
+
+      constexpr auto term() -> uint32_t {
+        return left_associative({Kind::PLUS, Kind::MINUS}, [this] {
+          return factor();
+        });
+      }
+
+      constexpr auto factor() -> uint32_t {
+        return left_associative({Kind::STAR, Kind::SLASH}, [this] {
+          return unary();
+        });
+      }
+
+      constexpr auto unary() -> uint32_t {
+        if (!match({Kind::BANG, Kind::MINUS})) {
+          return primary();
+        }
+        auto const operation = last().kind;
+        auto const operand = unary();
+        auto const type = tree_.nodes[operand].type;
+        if (operation == Kind::MINUS && type != Type::NUMBER) {
+          throw std::logic_error("sign negation only operates on numbers");
+        }
+        if (operation == Kind::BANG && type != Type::BOOL) {
+          throw std::logic_error("not operator only operates on booleans");
+        }
+        return add(Node{
+            .kind = Node::Kind::UNARY,
+            .type = type,
+            .operation = operation,
+            .left = operand
+        });
+      }
+
+      constexpr auto primary() -> uint32_t {
+        if (match({Kind::NUMBER})) {
+          return add(Node{.kind = Node::Kind::NUMBER, .number = last().number}
+          );
+        }
+        if (match({Kind::TRUE, Kind::FALSE})) {
+          return add(Node{
+              .kind = Node::Kind::BOOL,
+              .type = Type::BOOL,
+              .boolean = last().kind == Kind::TRUE
+          });
+        }
+        if (match({Kind::IDENTIFIER})) {
+          if (pos_ < count_ && lexemes_[pos_].kind == Kind::LEFT_PAREN) {
+            throw std::logic_error("functions need the runtime interpreter");
+          }
+          return add(Node{
+              .kind = Node::Kind::PARAMETER, .parameter = parameter(last())
+          });
+        }
+        if (match({Kind::LEFT_PAREN})) {
+          auto const expression = this->expression();
+          if (!match({Kind::RIGHT_PAREN})) {
+            throw std::logic_error("missing )");
+          }
+          return expression;
+        }
+        if (match({Kind::LEFT_BRACE})) {
+          throw std::logic_error("arrays need the runtime interpreter");
+        }
+        throw std::logic_error("expected expression");
+      }
+
+      // Index of the parameter named by `identifier`, added on first use
+      constexpr auto parameter(Lexeme const& identifier) -> uint32_t {
+        auto const name = source_.substr(identifier.begin, identifier.length);
+        for (uint32_t i = 0; i < tree_.parameters; ++i) {
+          auto const known = tree_.names[i];
+          if (source_.substr(known.begin, known.length) == name) {
+            return i;
+          }
+        }
+        tree_.names[tree_.parameters] =
+            Name{.begin = identifier.begin, .length = identifier.length};
+        return tree_.parameters++;
+      }
+    };
+
+    template <size_t N>
+    consteval auto parse(FixedString<N> const& source) -> Tree<N> {
+      return Parser<N>{source.view()}.receive_tree();
+    }
+
+    // Instantiated once per node, with every branch but one discarded
+    template <auto TREE, uint32_t INDEX, size_t PARAMETERS>
+    constexpr auto evaluate(std::array<double, PARAMETERS> const& parameters) {
+      constexpr auto node = TREE.nodes[INDEX];
+      using Kind = Token::Kind;
+      if constexpr (node.kind == Node::Kind::NUMBER) {
+        return node.number;
+      } else if constexpr (node.kind == Node::Kind::BOOL) {
+        return node.boolean;
+      } else if constexpr (node.kind == Node::Kind::PARAMETER) {
+        return parameters[node.parameter];
+      } else if constexpr (node.kind == Node::Kind::UNARY) {
+        auto const operand = evaluate<TREE, node.left>(parameters);
+        if constexpr (node.operation == Kind::MINUS) {
+          return -operand;
+        } else {
+          return !operand;
+        }
+      } else {
+        auto const left = evaluate<TREE, node.left>(parameters);
+        auto const right = evaluate<TREE, node.right>(parameters);
+        if constexpr (node.operation == Kind::PLUS) {
+          return left + right;
+        } else if constexpr (node.operation == Kind::MINUS) {
+          return left - right;
+        } else if constexpr (node.operation == Kind::STAR) {
+          return left * right;
+        } else if constexpr (node.operation == Kind::SLASH) {
+          return left / right;
+        } else if constexpr (node.operation == Kind::GREATER) {
+          return left > right;
+        } else if constexpr (node.operation == Kind::GREATER_EQUAL) {
+          return left >= right;
+        } else if constexpr (node.operation == Kind::LESS) {
+          return left < right;
+        } else if constexpr (node.operation == Kind::LESS_EQUAL) {
+          return left <= right;
+        } else if constexpr (node.operation == Kind::EQUAL_EQUAL) {
+          return left == right;
+        } else {
+          return left != right;
+        }
+      }
+    }
+  } // namespace Static
+
+  // Expression compiled together with the host. Calling it with one number
+  // per parameter evaluates it, yielding a `double` or a `bool`
+  template <FixedString SOURCE, auto TREE> class Expression {
+  public:
+    using Result = std::conditional_t<
+        TREE.type == Static::Type::NUMBER, double, bool>;
+    static constexpr size_t PARAMETERS = TREE.parameters;
+
+    template <std::convertible_to<double>... Arguments>
+      requires(sizeof...(Arguments) == PARAMETERS)
+    constexpr auto operator()(Arguments const... arguments) const -> Result {
+      std::array<double, PARAMETERS> const parameters{
+          static_cast<double>(arguments)...
+      };
+      return Static::evaluate<TREE, TREE.root>(parameters);
+    }
+
+    // Name of the parameter at `index`
+    [[nodiscard]] static constexpr auto parameter(size_t const index)
+        -> std::string_view {
+      auto const name = TREE.names[index];
+      return SOURCE.view().substr(name.begin, name.length);
+    }
+  };
+
+  template <FixedString SOURCE> consteval auto compile() {
+    return Expression<SOURCE, Static::parse(SOURCE)>{};
+  }
+} // namespace Seashell
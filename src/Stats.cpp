@@ -0,0 +1,207 @@
+#include "Stats.hpp"
+
+#include <algorithm>
+#include <atomic>
+#include <bit>
+#include <cmath>
+#include <iterator>
+#include <map>
+#include <mutex>
+#include <vector>
+
+#include <fmt/format.h>
+
+namespace {
+  struct Registry {
+    std::mutex mutex;
+    // Sorted by name, so the JSON export is stable
+    std::map<std::string, Stats::Entry, std::less<>> entries;
+  };
+
+  std::atomic<bool> recording{false};
+
+  auto registry() -> Registry& {
+    static Registry instance{};
+    return instance;
+  }
+
+  auto milliseconds(std::chrono::microseconds const duration) -> double {
+    return static_cast<double>(duration.count()) / 1000.0;
+  }
+
+  auto milliseconds(uint64_t const microseconds) -> double {
+    return static_cast<double>(microseconds) / 1000.0;
+  }
+
+  // Entries sorted by total wall time, longest first
+  auto snapshot() -> std::vector<std::pair<std::string, Stats::Entry>> {
+    auto& shared = registry();
+    std::vector<std::pair<std::string, Stats::Entry>> entries{};
+    {
+      std::scoped_lock const lock{shared.mutex};
+      entries.assign(shared.entries.begin(), shared.entries.end());
+    }
+    std::ranges::stable_sort(
+        entries, std::ranges::greater{},
+        [](auto const& entry) { return entry.second.total.wall; }
+    );
+    return entries;
+  }
+
+  auto append_escaped(std::string& out, std::string_view const text) -> void {
+    for (auto const let : text) {
+      switch (let) {
+      case '"':
+        out += "\\\"";
+        break;
+      case '\\':
+        out += "\\\\";
+        break;
+      case '\n':
+        out += "\\n";
+        break;
+      case '\t':
+        out += "\\t";
+        break;
+      default:
+        if (static_cast<unsigned char>(let) < 0x20) {
+          fmt::format_to(std::back_inserter(out), "\\u{:04x}", let);
+        } else {
+          out += let;
+        }
+      }
+    }
+  }
+} // namespace
+
+namespace Stats {
+  auto Histogram::record(uint64_t const value) -> void {
+    ++counts_[index_of(value)];
+    ++count_;
+    sum_ += value;
+    min_ = std::min(min_, value);
+    max_ = std::max(max_, value);
+  }
+
+  [[nodiscard]] auto Histogram::mean() const -> double {
+    if (count_ == 0) {
+      return 0;
+    }
+    return static_cast<double>(sum_) / static_cast<double>(count_);
+  }
+
+  [[nodiscard]] auto Histogram::percentile(double const quantile) const
+      -> uint64_t {
+    if (count_ == 0) {
+      return 0;
+    }
+    auto const target = std::max<uint64_t>(
+        1, static_cast<uint64_t>(std::ceil(
+               std::clamp(quantile, 0.0, 1.0) * static_cast<double>(count_)
+           ))
+    );
+    uint64_t seen = 0;
+    for (size_t index = 0; index < SIZE; ++index) {
+      seen += counts_[index];
+      if (seen >= target) {
+        return std::min(highest_equivalent(index), max_);
+      }
+    }
+    return max_;
+  }
+
+  // Values below `2 * HALF` are counted exactly. Above that, a value with
+  // `shift` extra bits lands in sub-bucket `value >> shift`, which lies in
+  // [HALF, 2 * HALF)
+  [[nodiscard]] auto Histogram::index_of(uint64_t const value) -> size_t {
+    auto const width = static_cast<unsigned>(std::bit_width(value));
+    auto const shift = width > SUB_BUCKET_BITS ? width - SUB_BUCKET_BITS : 0;
+    return (shift * HALF) + (value >> shift);
+  }
+
+  [[nodiscard]] auto Histogram::highest_equivalent(size_t const index)
+      -> uint64_t {
+    auto const shift = index < 2 * HALF ? 0 : (index / HALF) - 1;
+    auto const lowest = (index - (shift * HALF)) << shift;
+    return lowest + ((uint64_t{1} << shift) - 1);
+  }
+
+  auto enable() -> void { recording.store(true, std::memory_order_relaxed); }
+
+  [[nodiscard]] auto enabled() -> bool {
+    return recording.load(std::memory_order_relaxed);
+  }
+
+  auto record(std::string_view const command, Usage const& usage) -> void {
+    if (!enabled()) {
+      return;
+    }
+    auto& shared = registry();
+    std::scoped_lock const lock{shared.mutex};
+    auto found = shared.entries.find(command);
+    if (found == shared.entries.end()) {
+      found = shared.entries.emplace(std::string{command}, Entry{}).first;
+    }
+    auto& entry = found->second;
+    entry.latency.record(static_cast<uint64_t>(usage.wall.count()));
+    entry.total.wall += usage.wall;
+    entry.total.user += usage.user;
+    entry.total.system += usage.system;
+    entry.total.voluntary_switches += usage.voluntary_switches;
+    entry.total.involuntary_switches += usage.involuntary_switches;
+    entry.peak_rss = std::max(entry.peak_rss, usage.max_rss);
+  }
+
+  [[nodiscard]] auto summary() -> std::string {
+    std::string out{};
+    auto it = std::back_inserter(out);
+    fmt::format_to(
+        it, "{:<20} {:>7} {:>10} {:>9} {:>9} {:>9} {:>9} {:>9} {:>9} {:>9} "
+            "{:>10} {:>9}\n",
+        "command", "calls", "total ms", "mean", "p50", "p90", "p99", "max",
+        "user ms", "sys ms", "peak KiB", "switches"
+    );
+    for (auto const& [command, entry] : snapshot()) {
+      auto const& latency = entry.latency;
+      fmt::format_to(
+          it, "{:<20} {:>7} {:>10.1f} {:>9.2f} {:>9.2f} {:>9.2f} {:>9.2f} "
+              "{:>9.2f} {:>9.1f} {:>9.1f} {:>10} {:>9}\n",
+          command, latency.count(), milliseconds(entry.total.wall),
+          latency.mean() / 1000.0, milliseconds(latency.percentile(0.5)),
+          milliseconds(latency.percentile(0.9)),
+          milliseconds(latency.percentile(0.99)), milliseconds(latency.max()),
+          milliseconds(entry.total.user), milliseconds(entry.total.system),
+          entry.peak_rss,
+          entry.total.voluntary_switches + entry.total.involuntary_switches
+      );
+    }
+    return out;
+  }
+
+  // Times are in microseconds and memory in KiB
+  [[nodiscard]] auto json() -> std::string {
+    std::string out{"{\"commands\":["};
+    auto it = std::back_inserter(out);
+    auto first = true;
+    for (auto const& [command, entry] : snapshot()) {
+      auto const& latency = entry.latency;
+      out += first ? "{\"name\":\"" : ",{\"name\":\"";
+      first = false;
+      append_escaped(out, command);
+      fmt::format_to(
+          it,
+          "\",\"calls\":{},\"wall\":{{\"total\":{},\"min\":{},\"mean\":{:.1f},"
+          "\"p50\":{},\"p90\":{},\"p99\":{},\"p999\":{},\"max\":{}}},"
+          "\"user\":{},\"system\":{},\"peak_rss\":{},"
+          "\"voluntary_switches\":{},\"involuntary_switches\":{}}}",
+          latency.count(), entry.total.wall.count(), latency.min(),
+          latency.mean(), latency.percentile(0.5), latency.percentile(0.9),
+          latency.percentile(0.99), latency.percentile(0.999), latency.max(),
+          entry.total.user.count(), entry.total.system.count(), entry.peak_rss,
+          entry.total.voluntary_switches, entry.total.involuntary_switches
+      );
+    }
+    out += "]}\n";
+    return out;
+  }
+} // namespace Stats
@@ -0,0 +1,73 @@
+#pragma once
+
+#include <array>
+#include <chrono>
+#include <cstdint>
+#include <string>
+#include <string_view>
+
+// Resource accounting of spawned commands. Every reaped child is recorded
+// under its command name while recording is enabled, keeping a latency
+// histogram and CPU, memory and scheduling totals per name
+namespace Stats {
+  // What `wait4` reports about a child, along with its wall time
+  struct Usage {
+    std::chrono::microseconds wall{};
+    std::chrono::microseconds user{};
+    std::chrono::microseconds system{};
+    // In KiB
+    uint64_t max_rss = 0;
+    uint64_t voluntary_switches = 0;
+    uint64_t involuntary_switches = 0;
+  };
+
+  // Log-linear histogram in the spirit of HdrHistogram. Values are grouped by
+  // their highest set bit into buckets of `HALF` equally wide sub-buckets, so
+  // the relative error stays below 1 / `HALF` over the whole `uint64_t` range
+  // with a fixed amount of counters
+  class Histogram {
+  public:
+    static constexpr unsigned SUB_BUCKET_BITS = 6;
+    static constexpr uint64_t HALF = 1U << (SUB_BUCKET_BITS - 1);
+
+    auto record(uint64_t value) -> void;
+
+    [[nodiscard]] inline auto count() const -> uint64_t { return count_; }
+    [[nodiscard]] inline auto min() const -> uint64_t { return min_; }
+    [[nodiscard]] inline auto max() const -> uint64_t { return max_; }
+    [[nodiscard]] auto mean() const -> double;
+    // Highest value equivalent to the one at `quantile` (0 to 1)
+    [[nodiscard]] auto percentile(double quantile) const -> uint64_t;
+
+  private:
+    static constexpr size_t SIZE = (64 - SUB_BUCKET_BITS + 2) * HALF;
+
+    [[nodiscard]] static auto index_of(uint64_t value) -> size_t;
+    [[nodiscard]] static auto highest_equivalent(size_t index) -> uint64_t;
+
+    std::array<uint64_t, SIZE> counts_{};
+    uint64_t count_ = 0;
+    uint64_t min_ = UINT64_MAX;
+    uint64_t max_ = 0;
+    // Kept exactly, for the mean
+    uint64_t sum_ = 0;
+  };
+
+  struct Entry {
+    // Wall time in microseconds
+    Histogram latency;
+    Usage total;
+    // Largest `max_rss` of a single run
+    uint64_t peak_rss = 0;
+  };
+
+  // Recording is off unless enabled, `record` is then a single branch
+  auto enable() -> void;
+  [[nodiscard]] auto enabled() -> bool;
+
+  auto record(std::string_view command, Usage const& usage) -> void;
+
+  // Session summary, one line per command sorted by total wall time
+  [[nodiscard]] auto summary() -> std::string;
+  [[nodiscard]] auto json() -> std::string;
+} // namespace Stats
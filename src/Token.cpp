@@ -22,6 +22,7 @@ namespace {
     map[std::to_underlying(Kind::SLASH)] = "/";
     map[std::to_underlying(Kind::STAR)] = "*";
     map[std::to_underlying(Kind::PERCENT)] = "%";
+    map[std::to_underlying(Kind::PIPE)] = "|";
     map[std::to_underlying(Kind::BANG)] = "!";
     map[std::to_underlying(Kind::BANG_EQUAL)] = "!=";
     map[std::to_underlying(Kind::EQUAL)] = "=";
@@ -30,18 +31,22 @@ namespace {
     map[std::to_underlying(Kind::GREATER_EQUAL)] = ">=";
     map[std::to_underlying(Kind::LESS)] = "<";
     map[std::to_underlying(Kind::LESS_EQUAL)] = "<=";
+    map[std::to_underlying(Kind::DOT_DOT)] = "..";
     map[std::to_underlying(Kind::IDENTIFIER)] = "unknown identifier";
     map[std::to_underlying(Kind::STRING)] = "unknown string";
     map[std::to_underlying(Kind::NUMBER)] = "unknown number";
+    map[std::to_underlying(Kind::SUBSTITUTION)] = "unknown substitution";
+    map[std::to_underlying(Kind::VARIABLE)] = "unknown variable";
     map[std::to_underlying(Kind::AND)] = "&&";
     map[std::to_underlying(Kind::BEGIN)] = "begin";
+    map[std::to_underlying(Kind::BREAK)] = "break";
     map[std::to_underlying(Kind::END)] = "end";
     map[std::to_underlying(Kind::ELSE)] = "else";
     map[std::to_underlying(Kind::FALSE)] = "false";
     map[std::to_underlying(Kind::FOR)] = "for";
     map[std::to_underlying(Kind::IF)] = "if";
     map[std::to_underlying(Kind::IN)] = "in";
-    map[std::to_underlying(Kind::OR)] = "or";
+    map[std::to_underlying(Kind::OR)] = "||";
     map[std::to_underlying(Kind::PRINT)] = "print";
     map[std::to_underlying(Kind::TRUE)] = "true";
     map[std::to_underlying(Kind::LET)] = "let";
@@ -49,7 +54,7 @@ namespace {
 
     return map;
   }
-  constinit auto KIND_MAP = init_kind_map();
+  constexpr auto KIND_MAP = init_kind_map();
 } // namespace
 
 // TODO: Might be possible to return a string_view of a static string?
@@ -70,6 +75,17 @@ namespace {
       return "number: " + std::to_string(std::get<double>(literal_.value()));
     }
     break;
+  case (Kind::VARIABLE):
+    if (literal_) {
+      return "variable: $" + std::get<std::string>(literal_.value());
+    }
+    break;
+  case (Kind::SUBSTITUTION):
+    if (literal_) {
+      return "substitution: $(" + std::get<std::string>(literal_.value()) +
+             ")";
+    }
+    break;
   // prevent the non-exhaustive matching warning
   default:
     break;
@@ -1,7 +1,11 @@
 #pragma once
+#include <algorithm>
+#include <array>
 #include <cstdint>
 #include <optional>
 #include <string>
+#include <string_view>
+#include <utility>
 #include <variant>
 
 class Token {
@@ -22,6 +26,7 @@ public:
     SLASH,
     STAR,
     PERCENT,
+    PIPE,
 
     // One or two character
     BANG,
@@ -32,15 +37,19 @@ public:
     GREATER_EQUAL,
     LESS,
     LESS_EQUAL,
+    DOT_DOT,
 
     // Literals.
     IDENTIFIER,
     STRING,
     NUMBER,
+    SUBSTITUTION,
+    VARIABLE,
 
     // Keywords.
     AND,
     BEGIN,
+    BREAK,
     END,
     ELSE,
     FALSE,
@@ -70,4 +79,58 @@ public:
       : kind_(kind), line_(line), literal_(std::move(literal)) {};
 
   [[nodiscard]] auto display() const -> std::string;
+
+  // Punctuation and keywords with a fixed spelling. Usable in constant
+  // expressions, so the compile-time front end (see `Static.hpp`) shares it
+  // with `Lexer`
+  [[nodiscard]] static constexpr auto keyword(std::string_view spelling)
+      -> std::optional<Kind>;
+
+private:
+  using Keyword = std::pair<std::string_view, Kind>;
+
+  // Sorted by spelling for binary search
+  static constexpr auto KEYWORDS = [] {
+    std::array keywords{
+        Keyword{"(", Kind::LEFT_PAREN},
+        Keyword{")", Kind::RIGHT_PAREN},
+        Keyword{"[", Kind::LEFT_BRACE},
+        Keyword{"]", Kind::RIGHT_BRACE},
+        Keyword{",", Kind::COMMA},
+        Keyword{":", Kind::COLLON},
+        Keyword{".", Kind::DOT},
+        Keyword{"-", Kind::MINUS},
+        Keyword{"+", Kind::PLUS},
+        Keyword{";", Kind::SEMICOLON},
+        Keyword{"/", Kind::SLASH},
+        Keyword{"*", Kind::STAR},
+        Keyword{"|", Kind::PIPE},
+        Keyword{"&&", Kind::AND},
+        Keyword{"begin", Kind::BEGIN},
+        Keyword{"break", Kind::BREAK},
+        Keyword{"end", Kind::END},
+        Keyword{"else", Kind::ELSE},
+        Keyword{"false", Kind::FALSE},
+        Keyword{"for", Kind::FOR},
+        Keyword{"if", Kind::IF},
+        Keyword{"in", Kind::IN},
+        Keyword{"||", Kind::OR},
+        Keyword{"print", Kind::PRINT},
+        Keyword{"true", Kind::TRUE},
+        Keyword{"let", Kind::LET},
+        Keyword{"while", Kind::WHILE},
+    };
+    std::ranges::sort(keywords, {}, &Keyword::first);
+    return keywords;
+  }();
 };
+
+constexpr auto Token::keyword(std::string_view const spelling)
+    -> std::optional<Kind> {
+  auto const found =
+      std::ranges::lower_bound(KEYWORDS, spelling, {}, &Keyword::first);
+  if (found == KEYWORDS.end() || found->first != spelling) {
+    return std::nullopt;
+  }
+  return found->second;
+}
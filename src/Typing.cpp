@@ -0,0 +1,228 @@
+#include "Typing.hpp"
+
+#include <algorithm>
+#include <utility>
+#include <vector>
+
+namespace {
+  using Kind = Token::Kind;
+  using Typing::Type;
+  using Specialization = Expr::Specialization;
+
+  [[nodiscard]] auto specialize_numbers(Kind const kind) -> Specialization {
+    switch (kind) {
+    case Kind::PLUS:
+      return Specialization::NUMBER_ADD;
+    case Kind::MINUS:
+      return Specialization::NUMBER_SUBTRACT;
+    case Kind::STAR:
+      return Specialization::NUMBER_MULTIPLY;
+    case Kind::SLASH:
+      return Specialization::NUMBER_DIVIDE;
+    case Kind::PERCENT:
+      return Specialization::NUMBER_MODULO;
+    case Kind::GREATER:
+      return Specialization::NUMBER_GREATER;
+    case Kind::GREATER_EQUAL:
+      return Specialization::NUMBER_GREATER_EQUAL;
+    case Kind::LESS:
+      return Specialization::NUMBER_LESS;
+    case Kind::LESS_EQUAL:
+      return Specialization::NUMBER_LESS_EQUAL;
+    case Kind::EQUAL_EQUAL:
+      return Specialization::NUMBER_EQUAL;
+    case Kind::BANG_EQUAL:
+      return Specialization::NUMBER_NOT_EQUAL;
+    default:
+      return Specialization::GENERIC;
+    }
+  }
+
+  [[nodiscard]] auto specialize_strings(Kind const kind) -> Specialization {
+    switch (kind) {
+    case Kind::PLUS:
+      return Specialization::STRING_CONCATENATE;
+    case Kind::EQUAL_EQUAL:
+      return Specialization::STRING_EQUAL;
+    case Kind::BANG_EQUAL:
+      return Specialization::STRING_NOT_EQUAL;
+    default:
+      return Specialization::GENERIC;
+    }
+  }
+
+  [[nodiscard]] auto result_type(Specialization const specialization) -> Type {
+    switch (specialization) {
+    case Specialization::GENERIC:
+      return Type::UNKNOWN;
+    case Specialization::NUMBER_ADD:
+    case Specialization::NUMBER_SUBTRACT:
+    case Specialization::NUMBER_MULTIPLY:
+    case Specialization::NUMBER_DIVIDE:
+    case Specialization::NUMBER_MODULO:
+      return Type::NUMBER;
+    case Specialization::STRING_CONCATENATE:
+      return Type::STRING;
+    default:
+      return Type::BOOL;
+    }
+  }
+
+  // Specialized operations evaluate their operands recursively, operations
+  // with more levels of nodes below them stay generic, which the interpreter
+  // evaluates without recursion
+  constexpr uint32_t MAX_SPECIALIZED_HEIGHT = 256;
+
+  struct Inferred {
+    Type type;
+    // Levels of nodes from this one down to its deepest leaf
+    uint32_t height;
+  };
+
+  [[nodiscard]] auto infer_literal(Token const& token) -> Type {
+    switch (token.kind_) {
+    case Kind::TRUE:
+    case Kind::FALSE:
+      return Type::BOOL;
+    case Kind::NUMBER:
+      return token.literal_ ? Type::NUMBER : Type::UNKNOWN;
+    case Kind::STRING:
+      return token.literal_ ? Type::STRING : Type::UNKNOWN;
+    default:
+      return Type::UNKNOWN;
+    }
+  }
+
+  auto infer_tree(Expr::T const& expression) -> Inferred;
+
+  [[nodiscard]] auto infer_all(std::vector<Expr::T> const& expressions)
+      -> uint32_t {
+    uint32_t height = 0;
+    for (auto const& expression : expressions) {
+      height = std::max(height, infer_tree(expression).height);
+    }
+    return height;
+  }
+
+  // Nodes other than operators, whose nesting is bounded by `Parser`
+  [[nodiscard]] auto infer_node(Expr::T const& expression) -> Inferred {
+    return std::visit(
+        overloads{
+            [](Expr::LiteralPtr const& expr) {
+              return Inferred{infer_literal(expr->token), 1};
+            },
+            // Commands and environment variables always produce strings
+            [](Expr::SubstitutionPtr const&) {
+              return Inferred{Type::STRING, 1};
+            },
+            [](Expr::VariablePtr const&) {
+              return Inferred{Type::STRING, 1};
+            },
+            // Operations on arrays stay generic, the work is done by the
+            // array kernels anyway
+            [](Expr::ArrayPtr const& expr) {
+              return Inferred{Type::ARRAY, infer_all(expr->elements) + 1};
+            },
+            // Every built-in function returns a number
+            [](Expr::CallPtr const& expr) {
+              return Inferred{Type::NUMBER, infer_all(expr->arguments) + 1};
+            },
+            // Loop variables take the type of every element
+            [](Expr::LocalPtr const&) { return Inferred{Type::UNKNOWN, 1}; },
+            // Statements are never operands, only their children are
+            // annotated
+            [](Expr::ForPtr const& expr) {
+              auto height = infer_tree(expr->iterable).height;
+              if (expr->last) {
+                height = std::max(
+                    height, infer_tree(expr->last.value()).height
+                );
+              }
+              height = std::max(height, infer_all(expr->body));
+              return Inferred{Type::UNKNOWN, height + 1};
+            },
+            [](Expr::BreakPtr const& expr) {
+              uint32_t height = 0;
+              if (expr->condition) {
+                height = infer_tree(expr->condition.value()).height;
+              }
+              return Inferred{Type::UNKNOWN, height + 1};
+            },
+            [](Expr::PrintPtr const& expr) {
+              return Inferred{
+                  Type::UNKNOWN, infer_tree(expr->expression).height + 1
+              };
+            },
+            [](auto const&) -> Inferred { std::unreachable(); }
+        },
+        expression
+    );
+  }
+
+  // Post-order walk over operators with an explicit stack, operands are
+  // inferred before the operation using them
+  auto infer_tree(Expr::T const& expression) -> Inferred {
+    struct Visit {
+      Expr::T const* node;
+      bool operands_inferred;
+    };
+    std::vector<Visit> pending{{&expression, false}};
+    std::vector<Inferred> inferred{};
+
+    while (!pending.empty()) {
+      auto const [node, operands_inferred] = pending.back();
+      pending.pop_back();
+
+      if (!operands_inferred) {
+        if (auto const* grouping = std::get_if<Expr::GroupingPtr>(node)) {
+          pending.push_back({node, true});
+          pending.push_back({&(*grouping)->expression, false});
+        } else if (auto const* unary = std::get_if<Expr::UnaryPtr>(node)) {
+          pending.push_back({node, true});
+          pending.push_back({&(*unary)->expression, false});
+        } else if (auto const* binary = std::get_if<Expr::BinaryPtr>(node)) {
+          pending.push_back({node, true});
+          pending.push_back({&(*binary)->right, false});
+          pending.push_back({&(*binary)->left, false});
+        } else {
+          inferred.push_back(infer_node(*node));
+        }
+        continue;
+      }
+
+      if (std::holds_alternative<Expr::GroupingPtr>(*node)) {
+        ++inferred.back().height;
+      } else if (auto const* unary = std::get_if<Expr::UnaryPtr>(node)) {
+        auto& operand = inferred.back();
+        auto const kind = (*unary)->operation.kind_;
+        if (!(kind == Kind::MINUS && operand.type == Type::NUMBER) &&
+            !(kind == Kind::BANG && operand.type == Type::BOOL)) {
+          operand.type = Type::UNKNOWN;
+        }
+        ++operand.height;
+      } else {
+        auto const& expr = std::get<Expr::BinaryPtr>(*node);
+        auto const right = inferred.back();
+        inferred.pop_back();
+        auto& left = inferred.back();
+        auto const height = std::max(left.height, right.height) + 1;
+        if (left.type != right.type || height > MAX_SPECIALIZED_HEIGHT) {
+          expr->specialization = Specialization::GENERIC;
+        } else if (left.type == Type::NUMBER) {
+          expr->specialization = specialize_numbers(expr->operation.kind_);
+        } else if (left.type == Type::STRING) {
+          expr->specialization = specialize_strings(expr->operation.kind_);
+        }
+        left = {result_type(expr->specialization), height};
+      }
+    }
+    return inferred.back();
+  }
+} // namespace
+
+namespace Typing {
+  auto infer(Expr::T const& expression) -> Type {
+    return infer_tree(expression).type;
+  }
+} // namespace Typing
+
@@ -0,0 +1,16 @@
+#pragma once
+#include "Expr.hpp"
+
+#include <cstdint>
+
+// Static type inference over expression trees. Binary operations whose
+// operand types are known are annotated with a specialization, letting the
+// interpreter skip the runtime type checks for them. Operations nested too
+// deep to evaluate recursively stay generic
+namespace Typing {
+  enum class Type : uint8_t { UNKNOWN, NUMBER, STRING, BOOL, ARRAY };
+
+  // Annotates `expression` and its children, returning its type. Has to run
+  // before the tree is shared with other threads
+  auto infer(Expr::T const& expression) -> Type;
+} // namespace Typing
@@ -0,0 +1,252 @@
+#include "Watch.hpp"
+#include "Interner.hpp"
+#include "Interpreter.hpp"
+#include "Lexer.hpp"
+#include "Log.hpp"
+#include "Parser.hpp"
+#include "Typing.hpp"
+
+#include <array>
+#include <cerrno>
+#include <chrono>
+#include <cstdio>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <iterator>
+#include <optional>
+#include <stdexcept>
+#include <string_view>
+#include <unordered_map>
+#include <variant>
+#include <vector>
+
+#include <fmt/core.h>
+#include <poll.h>
+#include <sys/inotify.h>
+#include <sysexits.h>
+#include <unistd.h>
+
+namespace {
+  using Clock = std::chrono::steady_clock;
+  using Literal = Interpreter::Literal;
+
+  // Editors save in several steps (e.g. write a copy, then rename it), events
+  // this close to each other belong to the same save
+  constexpr auto SETTLE = std::chrono::milliseconds{50};
+
+  // A top-level statement compiled from its text. Comments and blank text
+  // compile to no expressions at all
+  struct Statement {
+    std::vector<Expr::T> expressions;
+    uint32_t slots = 0;
+    bool pure = true;
+    // Value of the last evaluation, only kept for pure statements
+    std::optional<Literal> value{};
+  };
+
+  auto milliseconds(Clock::duration const duration) -> double {
+    return std::chrono::duration<double, std::milli>{duration}.count();
+  }
+
+  class Script {
+  public:
+    explicit Script(Seashell::Options const options) : options_(options) {}
+
+    // Compiles the statements of `source` missing from the cache, then
+    // evaluates them and prints the value of the last one
+    auto run(std::string_view source) -> void;
+
+  private:
+    // Statements by their text. Only the statements of the latest source
+    // are kept
+    std::unordered_map<std::string, Statement> cache_;
+    Seashell::Options options_;
+
+    [[nodiscard]] auto compile(Lexer::Chunk chunk) const
+        -> std::variant<Statement, std::string>;
+  };
+
+  [[nodiscard]] auto Script::compile(Lexer::Chunk const chunk) const
+      -> std::variant<Statement, std::string> {
+    Lexer lexer{chunk.source, chunk.first_line};
+    std::vector<Token> tokens{};
+    try {
+      tokens = lexer.receive_tokens();
+    } catch (std::logic_error const& error) {
+      return error.what();
+    }
+    Parser parser{std::move(tokens), options_.share_subexpressions};
+    auto result = parser.receive_statements();
+    if (auto* error = std::get_if<std::string>(&result)) {
+      return std::move(*error);
+    }
+
+    Statement statement{
+        .expressions = std::get<std::vector<Expr::T>>(std::move(result))
+    };
+    for (auto const& expression : statement.expressions) {
+      Typing::infer(expression);
+      statement.pure = Interner::is_pure(expression) && statement.pure;
+    }
+    if (options_.share_subexpressions) {
+      statement.slots = Interner::assign_slots(statement.expressions);
+    }
+    return statement;
+  }
+
+  auto Script::run(std::string_view const source) -> void {
+    auto const start = Clock::now();
+    std::unordered_map<std::string, Statement> cache{};
+    // Pointers to map values stay valid while the map grows
+    std::vector<Statement*> statements{};
+    size_t compiled = 0;
+
+    for (auto const& chunk : Lexer::statements(source)) {
+      std::string text{chunk.source};
+      auto found = cache.find(text);
+      if (found == cache.end()) {
+        if (auto node = cache_.extract(text)) {
+          found = cache.insert(std::move(node)).position;
+        } else {
+          auto statement = compile(chunk);
+          if (auto const* error = std::get_if<std::string>(&statement)) {
+            Log::error("{}", *error);
+            // Whatever compiled is still valid for the next save
+            cache_.merge(cache);
+            return;
+          }
+          found = cache
+                      .emplace(
+                          std::move(text),
+                          std::get<Statement>(std::move(statement))
+                      )
+                      .first;
+          ++compiled;
+        }
+      }
+      statements.push_back(&found->second);
+    }
+    cache_ = std::move(cache);
+    auto const compiled_at = Clock::now();
+
+    Interpreter interpreter{};
+    std::optional<Literal> result{};
+    size_t evaluated = 0;
+    for (auto* const statement : statements) {
+      if (statement->expressions.empty()) {
+        continue;
+      }
+      if (statement->value) {
+        result = statement->value;
+        continue;
+      }
+      result = interpreter.eval(statement->expressions, statement->slots);
+      ++evaluated;
+      if (!result) {
+        break;
+      }
+      if (statement->pure) {
+        statement->value = result;
+      }
+    }
+    auto const evaluated_at = Clock::now();
+
+    // Warnings raised during evaluation come before the result
+    Log::flush();
+    if (result) {
+      fmt::print("{}\n", Interpreter::display(result.value()));
+      std::fflush(stdout);
+    }
+    Log::info(
+        "{} statements: {} compiled in {:.2f} ms, {} evaluated in {:.2f} ms",
+        statements.size(), compiled, milliseconds(compiled_at - start),
+        evaluated, milliseconds(evaluated_at - compiled_at)
+    );
+    Log::flush();
+  }
+
+  auto read_file(std::string const& filename) -> std::optional<std::string> {
+    std::ifstream file{filename};
+    if (!file) {
+      return std::nullopt;
+    }
+    return std::string{
+        std::istreambuf_iterator<char>{file}, std::istreambuf_iterator<char>{}
+    };
+  }
+
+  // Blocks until `name` in the watched directory was written and no further
+  // events followed for `SETTLE`
+  auto wait_for_change(int const inotify, std::string_view const name)
+      -> bool {
+    alignas(inotify_event) std::array<char, 4096> buffer{};
+    auto timeout = -1;
+    for (;;) {
+      pollfd events{.fd = inotify, .events = POLLIN, .revents = 0};
+      auto const ready = poll(&events, 1, timeout);
+      if (ready == 0) {
+        return true;
+      }
+      auto const size =
+          ready == -1 ? -1 : read(inotify, buffer.data(), buffer.size());
+      if (size == -1 && errno == EINTR) {
+        continue;
+      }
+      if (size <= 0) {
+        return false;
+      }
+      for (ssize_t offset = 0; offset < size;) {
+        auto const* event =
+            reinterpret_cast<inotify_event const*>(buffer.data() + offset);
+        if (event->len != 0 && name == event->name) {
+          timeout = static_cast<int>(SETTLE.count());
+        }
+        offset += static_cast<ssize_t>(sizeof(inotify_event) + event->len);
+      }
+    }
+  }
+} // namespace
+
+namespace Watch {
+  auto run(std::string const& filename, Seashell::Options const options)
+      -> int {
+    auto source = read_file(filename);
+    if (!source) {
+      Log::error("Could not open \"{}\"", filename);
+      return EX_NOINPUT;
+    }
+
+    // The directory is watched since editors often replace the file instead
+    // of writing to it
+    std::filesystem::path const path{filename};
+    auto const directory = path.has_parent_path() ? path.parent_path()
+                                                  : std::filesystem::path{"."};
+    auto const name = path.filename().string();
+    auto const inotify = inotify_init1(IN_CLOEXEC);
+    if (inotify == -1 ||
+        inotify_add_watch(
+            inotify, directory.c_str(), IN_CLOSE_WRITE | IN_MOVED_TO
+        ) == -1) {
+      Log::error("Could not watch \"{}\": {}", filename, std::strerror(errno));
+      return EX_OSERR;
+    }
+
+    Script script{options};
+    for (;;) {
+      if (source) {
+        script.run(source.value());
+      } else {
+        Log::error("Could not open \"{}\"", filename);
+      }
+      if (!wait_for_change(inotify, name)) {
+        Log::error(
+            "Stopped watching \"{}\": {}", filename, std::strerror(errno)
+        );
+        close(inotify);
+        return EX_IOERR;
+      }
+      source = read_file(filename);
+    }
+  }
+} // namespace Watch
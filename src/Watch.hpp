@@ -0,0 +1,14 @@
+#pragma once
+#include "Seashell.hpp"
+
+#include <string>
+
+// `--watch` mode: runs a script and runs it again every time it is saved.
+// Statements are compiled once per distinct text and pure statements are
+// evaluated once, so a run after an edit only lexes, parses and evaluates
+// the statements that were touched, plus the ones running commands or
+// printing
+namespace Watch {
+  // Returns only when the script can not be watched anymore
+  auto run(std::string const& filename, Seashell::Options options) -> int;
+} // namespace Watch
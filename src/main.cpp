@@ -1,90 +1,179 @@
+#include "Command.hpp"
+#include "Environment.hpp"
+#include "ForkServer.hpp"
+#include "History.hpp"
+#include "LineEditor.hpp"
+#include "Log.hpp"
+#include "Seashell.hpp"
+#include "Stats.hpp"
+#include "Watch.hpp"
+
+#include <algorithm>
 #include <array>
 #include <climits>
+#include <cstdio>
 #include <filesystem>
-#include <istream>
+#include <fstream>
+#include <iostream>
+#include <iterator>
 #include <optional>
 #include <ranges>
+#include <stdexcept>
 #include <string>
 #include <string_view>
+#include <thread>
 
-#include <fmt/color.h>
 #include <fmt/core.h>
 #include <fmt/format.h>
 #include <lyra/lyra.hpp>
-#include <sys/wait.h>
 #include <sysexits.h>
 #include <unistd.h>
 
-constexpr auto eprintln(std::string message) -> void {
-  using namespace fmt;
-  print("{} {}\n", format(fg(color::pale_violet_red), "[ERROR]"), message);
-}
+auto prompt() -> std::string {
+  std::array<char, HOST_NAME_MAX> hostname{0};
+  gethostname(hostname.data(), sizeof(hostname) - 1);
 
-auto execute_command(std::string_view const line) -> void {
-  static constexpr auto MAX_ARGS = 1 << 8;
+  auto const cwd = std::filesystem::current_path();
 
-  // Arguments ownership holder
-  std::vector<std::string> argv{};
-  std::array<char const*, MAX_ARGS> c_argv{0};
+  return fmt::format("[{}@{}]$ ", hostname.data(), cwd.c_str());
+}
 
-  std::ranges::for_each(
-      std::ranges::views::split(line, ' '),
-      [&argv](auto const& arg) {
-        argv.emplace_back(std::string{arg.begin(), arg.end()});
-      }
-  );
+auto history_path() -> std::string {
+  auto& environment = Environment::global();
+  if (auto path = environment.get("SEASHELL_HISTORY")) {
+    return std::move(path.value());
+  }
+  return environment.get("HOME").value_or(".") + "/.seashell_history";
+}
 
-  for (auto i = 0U; i < argv.size(); ++i) {
-    c_argv[i] = argv[i].c_str();
+auto run_file(std::string const& filename, Seashell::Options const options)
+    -> int {
+  std::ifstream file{filename};
+  if (!file) {
+    Log::error("Could not open \"{}\"", filename);
+    return EX_NOINPUT;
   }
+  std::string const source{
+      std::istreambuf_iterator<char>{file}, std::istreambuf_iterator<char>{}
+  };
 
-  auto const child_pid = fork();
+  auto const program = Seashell::Program::compile(source, {}, options);
+  if (!program) {
+    return EX_DATAERR;
+  }
+  Seashell::Context context{};
+  auto const result = program->eval(context);
+  // Warnings raised during evaluation come before the result
+  Log::flush();
+  if (result) {
+    fmt::print("{}\n", Seashell::display(result.value()));
+    return EX_OK;
+  }
+  return EX_SOFTWARE;
+}
 
-  switch (child_pid) {
-  case -1:
-    [[unlikely]] eprintln("Could not fork. Computer resources might limited. "
-                          "Please try again later.");
-    std::exit(EX_OSERR);
-    break;
-  case 0:
-    if (execvp(argv[0].c_str(), const_cast<char* const*>(c_argv.data())) ==
-        -1) {
-      eprintln("Could not execute the specified command");
+auto run_repl() -> int {
+  History history{history_path()};
+  LineEditor editor{history};
+  while (auto const line = editor.read_line(prompt())) {
+    if (line->find_first_not_of(' ') == std::string::npos) {
+      continue;
+    }
+    history.add(line.value());
+    if (line == "exit") {
+      break;
+    }
+    Command::Invocation invocation{};
+    try {
+      invocation = Command::parse(line.value());
+    } catch (std::logic_error const& error) {
+      Log::error("{}", error.what());
+      continue;
+    }
+    // Here-document bodies are the lines following the command
+    for (auto& redirection : invocation.redirections) {
+      if (redirection.kind != Command::Redirection::Kind::HERE_DOCUMENT) {
+        continue;
+      }
+      for (auto body = editor.read_line("> ");
+           body && body != redirection.target; body = editor.read_line("> ")) {
+        redirection.content += body.value();
+        redirection.content += '\n';
+      }
     }
-    break;
-  default:
-    waitpid(child_pid, nullptr, 0);
+    Command::execute(invocation);
   }
+  return EX_OK;
 }
 
-auto display_prompt() -> void {
-  std::array<char, HOST_NAME_MAX> hostname{0};
-  gethostname(hostname.data(), sizeof(hostname) - 1);
-
-  auto const cwd = std::filesystem::current_path();
-
-  fmt::print("[{}@{}]$ ", hostname.data(), cwd.c_str());
+auto report_stats(bool const summary, std::optional<std::string> const& path)
+    -> int {
+  if (summary) {
+    Log::flush();
+    fmt::print(stderr, "{}", Stats::summary());
+  }
+  if (path) {
+    std::ofstream file{path.value()};
+    file << Stats::json();
+    if (!file) {
+      Log::error("Could not write statistics to \"{}\"", path.value());
+      return EX_CANTCREAT;
+    }
+  }
+  return EX_OK;
 }
 
 auto main(int argc, char** argv) -> int {
   std::optional<std::string> filename{};
+  std::optional<std::string> stats_path{};
+  bool stats = false;
+  bool fork_server = false;
+  bool watch = false;
+  Seashell::Options options{
+      .front_end_threads = std::max(std::thread::hardware_concurrency(), 1U)
+  };
 
   auto cli_parser =
       lyra::cli() |
-      lyra::opt(filename, "file").name("-f").name("--file").optional();
+      lyra::opt(filename, "file").name("-f").name("--file").optional() |
+      lyra::opt(options.share_subexpressions)
+          .name("--cse")
+          .help("Share and evaluate repeated subexpressions once") |
+      lyra::opt(stats)
+          .name("--stats")
+          .help("Print resource usage per command when exiting") |
+      lyra::opt(stats_path, "path")
+          .name("--stats-json")
+          .help("Write resource usage per command as JSON when exiting")
+          .optional() |
+      lyra::opt(fork_server)
+          .name("--fork-server")
+          .help("Spawn commands from a helper process started right away") |
+      lyra::opt(watch)
+          .name("--watch")
+          .help("Run the file again whenever it changes, reusing unchanged "
+                "statements");
   auto const parse_result = cli_parser.parse({argc, argv});
   if (!parse_result) {
-    eprintln(parse_result.message());
+    Log::error("{}", parse_result.message());
+    return EX_USAGE;
+  }
+  if (watch && !filename) {
+    Log::error("--watch requires a file");
     return EX_USAGE;
   }
 
-  display_prompt();
-  for (std::string line;
-       std::getline(std::cin >> std::ws, line);) {
-    if(line == "exit") {
-      break;
-    }
-    execute_command(line);
-    display_prompt();
+  // Before anything else grows the heap
+  if (fork_server && !ForkServer::start()) {
+    Log::warn("Could not start the fork server");
   }
+  if (stats || stats_path) {
+    Stats::enable();
+  }
+
+  auto const status = watch ? Watch::run(filename.value(), options)
+                      : filename ? run_file(filename.value(), options)
+                                 : run_repl();
+  auto const stats_status = report_stats(stats, stats_path);
+  return status != EX_OK ? status : stats_status;
 }
@@ -0,0 +1,74 @@
+// Shared subexpressions (`--cse`): repeated subexpressions get a memo slot
+// and evaluate to what they evaluate to without sharing
+#include "Interner.hpp"
+#include "Interpreter.hpp"
+#include "Lexer.hpp"
+#include "Parser.hpp"
+#include "Typing.hpp"
+
+#include <cstdint>
+#include <cstdlib>
+#include <string>
+#include <string_view>
+#include <variant>
+#include <vector>
+
+#include <fmt/core.h>
+
+namespace {
+  struct Case {
+    std::string_view source;
+    double value;
+    uint32_t slots;
+  };
+
+  constexpr Case CASES[]{
+      {.source = "2 * 3 + 2 * 3", .value = 12, .slots = 1},
+      {.source = "(2 * 3) + (2 * 3)", .value = 12, .slots = 1},
+      {.source = "-(1 + 2) * -(1 + 2)", .value = 9, .slots = 1},
+      {.source = "1 + 2 * 3 - 4", .value = 3, .slots = 0},
+  };
+
+  auto check(Case const& test) -> bool {
+    Lexer lexer{test.source};
+    Parser parser{lexer.receive_tokens(), true};
+    auto result = parser.receive_statements();
+    if (auto const* error = std::get_if<std::string>(&result)) {
+      fmt::print(stderr, "{}: {}\n", test.source, *error);
+      return false;
+    }
+    auto const& statements = std::get<std::vector<Expr::T>>(result);
+    for (auto const& statement : statements) {
+      Typing::infer(statement);
+    }
+
+    auto passed = true;
+    auto const slots = Interner::assign_slots(statements);
+    if (slots != test.slots) {
+      fmt::print(
+          stderr, "{}: {} slots, expected {}\n", test.source, slots,
+          test.slots
+      );
+      passed = false;
+    }
+    Interpreter interpreter{};
+    auto const value = interpreter.eval(statements, slots);
+    if (!value || !std::holds_alternative<double>(value.value()) ||
+        std::get<double>(value.value()) != test.value) {
+      fmt::print(
+          stderr, "{}: evaluated to {}, expected {}\n", test.source,
+          value ? Interpreter::display(value.value()) : "an error", test.value
+      );
+      passed = false;
+    }
+    return passed;
+  }
+} // namespace
+
+auto main() -> int {
+  auto passed = true;
+  for (auto const& test : CASES) {
+    passed = check(test) && passed;
+  }
+  return passed ? EXIT_SUCCESS : EXIT_FAILURE;
+}
@@ -0,0 +1,90 @@
+// Operators nest arbitrarily deep in every pass over the tree, with and
+// without shared subexpressions. Arrays, calls and loops, which nest through
+// recursion, are rejected past a limit
+#include "Interner.hpp"
+#include "Interpreter.hpp"
+#include "Lexer.hpp"
+#include "Parser.hpp"
+#include "Typing.hpp"
+
+#include <cstdlib>
+#include <string>
+#include <variant>
+#include <vector>
+
+#include <fmt/core.h>
+
+namespace {
+  constexpr size_t DEPTH = 100000;
+
+  auto repeat(std::string_view const text, size_t const count) -> std::string {
+    std::string out{};
+    out.reserve(text.size() * count);
+    for (size_t i = 0; i < count; ++i) {
+      out += text;
+    }
+    return out;
+  }
+
+  auto check(
+      std::string_view const name, std::string const& source,
+      double const expected, bool const hash_consing
+  ) -> bool {
+    Lexer lexer{source};
+    Parser parser{lexer.receive_tokens(), hash_consing};
+    auto result = parser.receive_statements();
+    if (auto const* error = std::get_if<std::string>(&result)) {
+      fmt::print(stderr, "{}: {}\n", name, *error);
+      return false;
+    }
+    auto const& statements = std::get<std::vector<Expr::T>>(result);
+    for (auto const& statement : statements) {
+      Typing::infer(statement);
+    }
+    auto const slots = Interner::assign_slots(statements);
+
+    Interpreter interpreter{};
+    auto const value = interpreter.eval(statements, slots);
+    if (!value || !std::holds_alternative<double>(value.value()) ||
+        std::get<double>(value.value()) != expected) {
+      fmt::print(
+          stderr, "{}: evaluated to {}, expected {}\n", name,
+          value ? Interpreter::display(value.value()) : "an error", expected
+      );
+      return false;
+    }
+    return true;
+  }
+
+  auto rejects(std::string_view const name, std::string const& source)
+      -> bool {
+    Lexer lexer{source};
+    Parser parser{lexer.receive_tokens()};
+    auto const result = parser.receive_statements();
+    auto const* error = std::get_if<std::string>(&result);
+    if (error == nullptr || !error->ends_with("nested too deeply")) {
+      fmt::print(stderr, "{}: expected a syntax error\n", name);
+      return false;
+    }
+    return true;
+  }
+} // namespace
+
+auto main() -> int {
+  auto const flat = "1" + repeat(" + 1", DEPTH);
+  auto const nested = repeat("(1 + ", DEPTH) + "1" + repeat(")", DEPTH);
+  auto const negated = repeat("-", DEPTH) + "1";
+  auto const generic = repeat("(1 + ", DEPTH) + "sum([1])" + repeat(")", DEPTH);
+
+  auto passed = true;
+  for (auto const hash_consing : {false, true}) {
+    passed = check("flat", flat, DEPTH + 1, hash_consing) && passed;
+    passed = check("nested", nested, DEPTH + 1, hash_consing) && passed;
+    passed = check("negated", negated, 1, hash_consing) && passed;
+    passed = check("generic", generic, DEPTH + 1, hash_consing) && passed;
+  }
+  passed = rejects("arrays", repeat("[", 300) + repeat("]", 300)) && passed;
+  passed = rejects("calls", repeat("sum(", 300) + repeat(")", 300)) && passed;
+  passed = rejects("pipes", "[1]" + repeat(" | len", DEPTH)) && passed;
+  return passed ? EXIT_SUCCESS : EXIT_FAILURE;
+}
@@ -0,0 +1,77 @@
+// Splitting scripts between top-level statements, as done for `--watch` and
+// for lexing chunks in parallel
+#include "Lexer.hpp"
+
+#include <cstdlib>
+#include <string_view>
+#include <vector>
+
+#include <fmt/core.h>
+#include <fmt/ranges.h>
+
+namespace {
+  struct Case {
+    std::string_view source;
+    std::vector<std::string_view> statements;
+  };
+
+  auto const CASES = std::vector<Case>{
+      {.source = "1; 2", .statements = {"1;", " 2"}},
+      {.source = "\"a;b\"; %% c;\n2;",
+       .statements = {"\"a;b\";", " %% c;\n2;"}},
+      {.source = "$(echo a; echo b); 2",
+       .statements = {"$(echo a; echo b);", " 2"}},
+      {.source = "sum([1; 2]); 3", .statements = {"sum([1; 2]);", " 3"}},
+      // Substitutions inside loop bodies and parentheses leave the depth
+      // around them as it was
+      {.source = "for x in 1..3 begin print $(echo a); print x end; 5",
+       .statements =
+           {"for x in 1..3 begin print $(echo a); print x end;", " 5"}},
+      {.source = "(1 + $(echo (a)); 2); 3",
+       .statements = {"(1 + $(echo (a)); 2);", " 3"}},
+  };
+
+  auto check(Case const& test) -> bool {
+    std::vector<std::string_view> statements{};
+    for (auto const& chunk : Lexer::statements(test.source)) {
+      statements.push_back(chunk.source);
+    }
+    if (statements != test.statements) {
+      fmt::print(
+          stderr, "{:?}: split into {}, expected {}\n", test.source,
+          statements, test.statements
+      );
+      return false;
+    }
+
+    // Whatever the number of chunks, they are made of whole statements
+    for (size_t count = 1; count <= test.statements.size() + 1; ++count) {
+      auto const chunks = Lexer::split(test.source, count);
+      auto statement = test.statements.begin();
+      for (auto const& chunk : chunks) {
+        auto rest = chunk.source;
+        while (!rest.empty() && statement != test.statements.end() &&
+               rest.starts_with(*statement)) {
+          rest.remove_prefix(statement->size());
+          ++statement;
+        }
+        if (!rest.empty()) {
+          fmt::print(
+              stderr, "{:?}: chunk {:?} splits a statement\n", test.source,
+              chunk.source
+          );
+          return false;
+        }
+      }
+    }
+    return true;
+  }
+} // namespace
+
+auto main() -> int {
+  auto passed = true;
+  for (auto const& test : CASES) {
+    passed = check(test) && passed;
+  }
+  return passed ? EXIT_SUCCESS : EXIT_FAILURE;
+}
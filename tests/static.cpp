@@ -0,0 +1,45 @@
+// Compile-time front end (`Static.hpp`). Everything is checked while this
+// file compiles, running it does nothing
+#include "Static.hpp"
+
+#include <concepts>
+
+namespace {
+  // Precedence and associativity
+  static_assert(Seashell::compile<"1 + 2 * 3">()() == 7);
+  static_assert(Seashell::compile<"(1 + 2) * 3">()() == 9);
+  static_assert(Seashell::compile<"10 - 4 - 3">()() == 3);
+  static_assert(Seashell::compile<"16 / 4 / 2">()() == 2);
+  static_assert(Seashell::compile<"1 + 2 * 3 - -4 / (2)">()() == 9);
+  static_assert(Seashell::compile<"-2 * 3">()() == -6);
+
+  // Parameters are numbered in order of first appearance
+  constexpr auto area = Seashell::compile<"width * height / 2">();
+  static_assert(area(3, 4) == 6);
+  static_assert(decltype(area)::PARAMETERS == 2);
+  static_assert(decltype(area)::parameter(0) == "width");
+  static_assert(decltype(area)::parameter(1) == "height");
+  static_assert(Seashell::compile<"x + x * y">()(2, 3) == 8);
+  static_assert(Seashell::compile<"b - a">()(1, 3) == -2);
+
+  // `!` and comparisons produce booleans
+  constexpr auto small = Seashell::compile<"!(x * 2 >= 10.25)">();
+  static_assert(std::same_as<decltype(small)::Result, bool>);
+  static_assert(small(1) && small(5) && !small(6));
+  static_assert(Seashell::compile<"2 * 3 == 6">()());
+  static_assert(!Seashell::compile<"1 + 2 < 3">()());
+  static_assert(
+      std::same_as<decltype(Seashell::compile<"1 + 2">())::Result, double>
+  );
+
+  // Number lexing, comments and whitespace
+  static_assert(Seashell::compile<"0.1 + 2.5">()() == 0.1 + 2.5);
+  static_assert(Seashell::compile<"1234567.875">()() == 1234567.875);
+  static_assert(Seashell::compile<"%% comment\n 42 %% another\n">()() == 42);
+  static_assert(Seashell::compile<"\t1\r\n+\f2">()() == 3);
+
+  static_assert(Token::keyword("begin") == Token::Kind::BEGIN);
+  static_assert(!Token::keyword("beginning"));
+} // namespace
+
+auto main() -> int {}